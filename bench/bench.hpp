@@ -0,0 +1,171 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ios>
+#include <iostream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+// Amount of work done by a single run.
+struct work {
+	std::uint64_t bytes   = 0;
+	std::uint64_t entries = 0;
+};
+
+struct result {
+	std::string name;
+
+	std::uint64_t runs;
+	double        seconds;  // Total of all runs.
+
+	work total;
+
+	double mb_per_s() const {
+		return static_cast<double>(this->total.bytes) / (1000 * 1000) / this->seconds;
+	}
+
+	double entries_per_s() const {
+		return static_cast<double>(this->total.entries) / this->seconds;
+	}
+};
+
+// Prevents the compiler from discarding computation of `v`.
+template<typename T>
+inline void keep(T const& v) {
+	asm volatile("" : : "g"(&v) : "memory");
+}
+
+// Output buffer that keeps nothing but still tracks the position so it can be seeked.
+// Written bytes are copied into a small scratch buffer so the cost of moving them is measured.
+class null_streambuf: public std::streambuf {
+   protected:
+	int_type overflow(int_type c) override {
+		if(!traits_type::eq_int_type(c, traits_type::eof())) {
+			this->scratch_[0] = traits_type::to_char_type(c);
+			this->advance_(1);
+		}
+		return traits_type::not_eof(c);
+	}
+
+	std::streamsize xsputn(char_type const* s, std::streamsize n) override {
+		for(std::streamsize done = 0; done < n;) {
+			auto const l = std::min<std::streamsize>(n - done, this->scratch_.size());
+			std::copy_n(s + done, l, this->scratch_.data());
+			done += l;
+		}
+		keep(this->scratch_);
+
+		this->advance_(n);
+		return n;
+	}
+
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+		switch(dir) {
+		case std::ios_base::beg:
+			return this->seekpos(off, which);
+		case std::ios_base::cur:
+			return this->seekpos(this->pos_ + off, which);
+		case std::ios_base::end:
+			return this->seekpos(this->end_ + off, which);
+		default:
+			return pos_type(off_type(-1));
+		}
+	}
+
+	pos_type seekpos(pos_type pos, std::ios_base::openmode) override {
+		if(pos < 0) {
+			return pos_type(off_type(-1));
+		}
+
+		this->pos_ = pos;
+		return pos;
+	}
+
+   private:
+	void advance_(std::streamsize n) {
+		this->pos_ += n;
+		this->end_ = std::max<off_type>(this->end_, this->pos_);
+	}
+
+	std::vector<char> scratch_ = std::vector<char>(64 * 1024);
+
+	off_type pos_ = 0;
+	off_type end_ = 0;
+};
+
+// Runs benchmarks and reports them as a JSON document on destruction.
+// Each benchmark is run repeatedly until `--min-time` seconds (1 by default) pass.
+class suite {
+   public:
+	suite(std::string name, int argc, char* argv[])
+	    : name_(std::move(name)) {
+		for(int i = 1; i + 1 < argc; ++i) {
+			if(std::string_view(argv[i]) == "--min-time") {
+				this->min_time_ = std::strtod(argv[i + 1], nullptr);
+			}
+		}
+	}
+
+	suite(suite const& other) = delete;
+
+	~suite() {
+		this->report(std::cout);
+	}
+
+	// `f` does a single run and returns the amount of work it did.
+	template<typename F>
+	void run(std::string name, F&& f) {
+		using clock = std::chrono::steady_clock;
+
+		result r{.name = std::move(name), .runs = 0, .seconds = 0};
+		while(r.runs == 0 || r.seconds < this->min_time_) {
+			auto const t0 = clock::now();
+			auto const w  = f();
+			auto const t1 = clock::now();
+
+			r.runs++;
+			r.seconds += std::chrono::duration<double>(t1 - t0).count();
+			r.total.bytes += w.bytes;
+			r.total.entries += w.entries;
+		}
+
+		std::clog << this->name_ << '/' << r.name << ": " << r.mb_per_s() << " MB/s, " << r.entries_per_s() << " entries/s" << std::endl;
+		this->results_.emplace_back(std::move(r));
+	}
+
+	void report(std::ostream& o) const {
+		o << "{\"suite\":\"" << this->name_ << "\",\"results\":[";
+		for(std::size_t i = 0; i < this->results_.size(); ++i) {
+			auto const& r = this->results_[i];
+			if(i > 0) {
+				o << ',';
+			}
+			o << "{\"name\":\"" << r.name << '"'
+			  << ",\"runs\":" << r.runs
+			  << ",\"seconds\":" << r.seconds
+			  << ",\"bytes\":" << r.total.bytes
+			  << ",\"entries\":" << r.total.entries
+			  << ",\"mb_per_s\":" << r.mb_per_s()
+			  << ",\"entries_per_s\":" << r.entries_per_s()
+			  << '}';
+		}
+		o << "]}" << std::endl;
+	}
+
+   private:
+	std::string name_;
+	double      min_time_ = 1;
+
+	std::vector<result> results_;
+};
+
+}  // namespace bench
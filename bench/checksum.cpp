@@ -0,0 +1,45 @@
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <tar/detail/checksum.hpp>
+
+#include "bench.hpp"
+
+int main(int argc, char* argv[]) {
+	bench::suite s("checksum", argc, argv);
+
+	using tar::detail::SumBlockSize;
+
+	std::size_t constexpr Count = 10'000;
+
+	// Offset by one so the blocks are unaligned, as headers in a buffer may be.
+	std::vector<std::uint8_t> data(Count * SumBlockSize + 1);
+	for(std::size_t i = 0; i < data.size(); ++i) {
+		data[i] = static_cast<std::uint8_t>(i * 31);
+	}
+	auto const* const blocks = data.data() + 1;
+
+	auto const sum_all = [&](auto f) {
+		return [&, f] {
+			std::uint32_t sum = 0;
+			for(std::size_t i = 0; i < Count; ++i) {
+				sum += f(blocks + i * SumBlockSize);
+			}
+			bench::keep(sum);
+
+			return bench::work{.bytes = Count * SumBlockSize, .entries = Count};
+		};
+	};
+
+	s.run("sum_block_scalar", sum_all(tar::detail::sum_block_scalar));
+	s.run("sum_block", sum_all(tar::detail::sum_block));
+#if defined(__x86_64__) || defined(__i386__)
+	s.run("sum_block_sse2", sum_all(tar::detail::sum_block_sse2));
+	if(tar::detail::has_avx2()) {
+		s.run("sum_block_avx2", sum_all(tar::detail::sum_block_avx2));
+	}
+#endif
+
+	return 0;
+}
@@ -0,0 +1,68 @@
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <tar/ustar.hpp>
+
+#include "bench.hpp"
+
+int main(int argc, char* argv[]) {
+	bench::suite s("header", argc, argv);
+
+	std::size_t constexpr Count = 10'000;
+
+	std::vector<tar::header> headers;
+	headers.reserve(Count);
+	for(std::size_t i = 0; i < Count; ++i) {
+		headers.push_back(tar::header{
+		    .path        = "some/directory/" + std::to_string(i / 100) + "/file-" + std::to_string(i),
+		    .permissions = std::filesystem::perms(0644),
+		    .uid         = 1000,
+		    .gid         = 1000,
+		    .size        = i * 1024,
+		    .type        = tar::file_type::regular,
+		    .user_name   = "user",
+		    .group_name  = "group",
+		});
+	}
+
+	std::vector<tar::ustar::header> blocks;
+	blocks.reserve(Count);
+	for(auto const& h: headers) {
+		blocks.push_back(tar::ustar::header::from(h));
+	}
+
+	s.run("header::from", [&] {
+		for(auto const& h: headers) {
+			auto const b = tar::ustar::header::from(h);
+			bench::keep(b);
+		}
+
+		return bench::work{.bytes = Count * sizeof(tar::ustar::header), .entries = Count};
+	});
+
+	s.run("operator tar::header", [&] {
+		for(auto& b: blocks) {
+			auto const h = static_cast<tar::header>(b);
+			bench::keep(h);
+		}
+
+		return bench::work{.bytes = Count * sizeof(tar::ustar::header), .entries = Count};
+	});
+
+	s.run("header_view", [&] {
+		for(auto const& b: blocks) {
+			tar::ustar::header_view const v(b);
+			bench::keep(v.name());
+			bench::keep(v.prefix());
+			bench::keep(v.uname());
+			bench::keep(v.gname());
+			bench::keep(v.size());
+			bench::keep(v.mtime());
+		}
+
+		return bench::work{.bytes = Count * sizeof(tar::ustar::header), .entries = Count};
+	});
+
+	return 0;
+}
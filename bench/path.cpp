@@ -0,0 +1,77 @@
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <tar/detail/marshal.hpp>
+#include <tar/patterns.hpp>
+
+#include "bench.hpp"
+
+namespace {
+
+std::vector<std::filesystem::path> make_paths(std::size_t n, std::size_t depth) {
+	std::vector<std::filesystem::path> ps;
+	ps.reserve(n);
+	for(std::size_t i = 0; i < n; ++i) {
+		std::filesystem::path p;
+		for(std::size_t d = 0; d < depth; ++d) {
+			p /= "directory-" + std::to_string(d);
+		}
+		ps.push_back(p / ("file-" + std::to_string(i)));
+	}
+
+	return ps;
+}
+
+bench::work split(std::vector<std::filesystem::path> const& ps) {
+	bench::work w;
+	for(auto const& p: ps) {
+		auto const v = tar::detail::split_ustar_path(p);
+		bench::keep(v);
+		w.bytes += p.native().size();
+	}
+
+	w.entries = ps.size();
+	return w;
+}
+
+bench::work match(tar::pattern_set const& patterns, std::vector<std::filesystem::path> const& ps) {
+	bench::work w;
+	for(auto const& p: ps) {
+		auto const v = patterns.selects(p.native());
+		bench::keep(v);
+		w.bytes += p.native().size();
+	}
+
+	w.entries = ps.size();
+	return w;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+	bench::suite s("path", argc, argv);
+
+	// Fits in the name field.
+	auto const short_paths = make_paths(10'000, 2);
+	// Needs the prefix field.
+	auto const long_paths = make_paths(10'000, 12);
+
+	s.run("split short paths", [&] { return split(short_paths); });
+	s.run("split long paths", [&] { return split(long_paths); });
+
+	// Allow-list of layers as in filtered extraction.
+	tar::pattern_set patterns;
+	for(std::size_t i = 0; i < 500; ++i) {
+		patterns.include("directory-0/directory-1/file-" + std::to_string(i * 20));
+		patterns.include("directory-0/layer-" + std::to_string(i) + "/**/*.so");
+	}
+	patterns.exclude("**/*.tmp");
+
+	s.run("match 1001 patterns, short paths", [&] { return match(patterns, short_paths); });
+	s.run("match 1001 patterns, long paths", [&] { return match(patterns, long_paths); });
+
+	return 0;
+}
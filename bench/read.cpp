@@ -0,0 +1,77 @@
+#include <cstddef>
+#include <cstdint>
+#include <spanstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <tar/ustar.hpp>
+
+#include "bench.hpp"
+
+namespace {
+
+// Archive of `n` entries each with body of `size` bytes.
+std::string make_archive(std::size_t n, std::size_t size) {
+	std::stringstream ss;
+	{
+		std::string const body(size, 'x');
+
+		tar::ustar::ostream o(ss.rdbuf());
+		for(std::size_t i = 0; i < n; ++i) {
+			o.next(tar::header{.path = "file-" + std::to_string(i), .size = size}, size);
+			o.write(body.data(), body.size());
+		}
+	}
+
+	return std::move(ss).str();
+}
+
+// Reads headers only; throughput is of the headers read.
+bench::work list(std::string const& archive) {
+	std::spanbuf       buf(std::span<char>(const_cast<char*>(archive.data()), archive.size()), std::ios_base::in);
+	tar::ustar::istream i(&buf);
+
+	bench::work w;
+	for(tar::ustar::header h; i.next(h);) {
+		w.entries++;
+	}
+
+	w.bytes = w.entries * sizeof(tar::ustar::header);
+	return w;
+}
+
+// Reads headers and bodies.
+bench::work read(std::string const& archive, std::vector<char>& body) {
+	std::spanbuf       buf(std::span<char>(const_cast<char*>(archive.data()), archive.size()), std::ios_base::in);
+	tar::ustar::istream i(&buf);
+
+	bench::work w;
+	for(tar::ustar::header h; i.next(h);) {
+		while(i.read(body.data(), body.size()) || i.gcount() > 0) {
+			w.bytes += i.gcount();
+		}
+		w.entries++;
+	}
+
+	bench::keep(body);
+	return w;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+	bench::suite s("read", argc, argv);
+
+	auto const small = make_archive(10'000, 1024);
+	auto const huge  = make_archive(4, 64 * 1024 * 1024);
+
+	std::vector<char> body(1024 * 1024);
+
+	s.run("list small files", [&] { return list(small); });
+	s.run("list huge files", [&] { return list(huge); });
+	s.run("read small files", [&] { return read(small, body); });
+	s.run("read huge files", [&] { return read(huge, body); });
+
+	return 0;
+}
@@ -0,0 +1,82 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <tar/ustar.hpp>
+
+#include "bench.hpp"
+
+namespace {
+
+std::vector<tar::header> small_headers(std::size_t n, std::size_t size) {
+	std::vector<tar::header> hs;
+	hs.reserve(n);
+	for(std::size_t i = 0; i < n; ++i) {
+		hs.push_back(tar::header{
+		    .path        = "dir/" + std::to_string(i / 100) + "/file-" + std::to_string(i),
+		    .permissions = std::filesystem::perms(0644),
+		    .size        = size,
+		    .type        = tar::file_type::regular,
+		    .user_name   = "user",
+		    .group_name  = "group",
+		});
+	}
+
+	return hs;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+	bench::suite s("write", argc, argv);
+
+	std::size_t constexpr SmallCount = 10'000;
+	std::size_t constexpr SmallSize  = 1024;
+
+	auto const        headers = small_headers(SmallCount, SmallSize);
+	std::string const small(SmallSize, 'x');
+
+	s.run("small files", [&] {
+		bench::null_streambuf buf;
+		tar::ustar::ostream   o(&buf);
+		for(auto const& h: headers) {
+			o.next(h);
+			o.write(small.data(), small.size());
+		}
+
+		return bench::work{.bytes = SmallCount * SmallSize, .entries = SmallCount};
+	});
+
+	s.run("small files with known size", [&] {
+		bench::null_streambuf buf;
+		tar::ustar::ostream   o(&buf);
+		for(auto const& h: headers) {
+			o.next(h, h.size);
+			o.write(small.data(), small.size());
+		}
+
+		return bench::work{.bytes = SmallCount * SmallSize, .entries = SmallCount};
+	});
+
+	std::size_t constexpr HugeCount = 4;
+	std::size_t constexpr HugeSize  = 256 * 1024 * 1024;
+	std::size_t constexpr ChunkSize = 1024 * 1024;
+
+	std::string const chunk(ChunkSize, 'x');
+
+	s.run("huge files", [&] {
+		bench::null_streambuf buf;
+		tar::ustar::ostream   o(&buf);
+		for(std::size_t i = 0; i < HugeCount; ++i) {
+			o.next(tar::header{.path = "huge-" + std::to_string(i), .size = HugeSize}, HugeSize);
+			for(std::size_t n = 0; n < HugeSize; n += ChunkSize) {
+				o.write(chunk.data(), chunk.size());
+			}
+		}
+
+		return bench::work{.bytes = HugeCount * HugeSize, .entries = HugeCount};
+	});
+
+	return 0;
+}
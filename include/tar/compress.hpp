@@ -0,0 +1,176 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <ios>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+namespace tar {
+
+enum class codec {
+	gzip,
+	zstd,  // Available only if built with libzstd.
+};
+
+// Tests if given codec is available in this build.
+bool supports(codec c);
+
+struct compress_options {
+	tar::codec codec = tar::codec::gzip;
+
+	// Compression level of the codec; -1 for its default.
+	int level = -1;
+
+	// Size of the blocks compressed independently of each other.
+	std::size_t block_size = 1024 * 1024;
+
+	// Number of threads compressing blocks; 0 to use all hardware threads.
+	std::size_t threads = 0;
+};
+
+// Member (frame) written by `compress_streambuf`.
+struct compressed_frame {
+	std::uint64_t offset;               // Offset in the compressed stream.
+	std::uint64_t uncompressed_offset;  // Offset of its content in the uncompressed stream.
+};
+
+// Output stream buffer that compresses what is written into `dst`.
+// The stream is cut into blocks which are compressed concurrently on a pool of threads
+// and written in order, each as an independent gzip member or zstd frame.
+// Concatenated members (frames) form a valid single stream so any decompressor can read the output.
+// The stream cannot be seeked, so entries of `ustar::ostream` are to be started with their size known.
+class compress_streambuf: public std::streambuf {
+   public:
+	// Throws `std::system_error` if the codec is not supported.
+	compress_streambuf(std::streambuf* dst, compress_options const& options = {});
+
+	compress_streambuf(compress_streambuf const& other) = delete;
+
+	// Finishes the stream; errors are ignored so call `finish` to see them.
+	~compress_streambuf();
+
+	compress_streambuf& operator=(compress_streambuf const& other) = delete;
+
+	// Compresses and writes everything written so far.
+	// Nothing can be written after this.
+	// Throws `std::system_error` if compression or writing to the destination fails.
+	void finish();
+
+	tar::codec codec() const {
+		return this->options_.codec;
+	}
+
+	// Ends the current block even if it is not full, so what is written next starts a new member (frame).
+	void cut();
+
+	// Number of bytes written to the destination so far.
+	std::uint64_t compressed_size() const {
+		return this->compressed_size_;
+	}
+
+	// Members (frames) written to the destination so far, in order.
+	std::span<compressed_frame const> frames() const {
+		return this->frames_;
+	}
+
+   protected:
+	// Only the current position can be told, which counts uncompressed bytes.
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::out) override;
+
+	// Ends the current block, even if it is not full, and writes all pending blocks to the destination.
+	int sync() override;
+
+	int_type overflow(int_type ch = traits_type::eof()) override;
+
+   private:
+	struct block {
+		std::vector<char> in;
+		std::vector<char> out;
+
+		std::uint64_t offset;  // Of `in` in the uncompressed stream.
+
+		std::exception_ptr error;
+
+		bool done = false;
+	};
+
+	void work_();
+
+	// Hands the put area to the workers as a block and makes a new put area.
+	// An empty put area is handed only if `force` is set.
+	void submit_(bool force = false);
+
+	// Writes pending blocks in order until no more than `n` remain.
+	void drain_(std::size_t n);
+
+	std::streambuf*  dst_;
+	compress_options options_;
+
+	std::uint64_t written_         = 0;  // Uncompressed bytes before the put area.
+	std::uint64_t compressed_size_ = 0;
+
+	std::vector<compressed_frame> frames_;
+
+	bool finished_ = false;
+
+	std::unique_ptr<block>              cur_;
+	std::deque<std::unique_ptr<block>>  pending_;  // In the order of the stream.
+	std::vector<std::unique_ptr<block>> free_;     // Reused to avoid allocation.
+
+	std::mutex              mutex_;
+	std::condition_variable cv_;
+	std::deque<block*>      queue_;  // Blocks not taken by workers yet.
+	bool                    stop_ = false;
+
+	std::vector<std::jthread> workers_;
+};
+
+// Input stream buffer that decompresses gzip members or zstd frames read from `src` from its current position.
+// Concatenated members (frames) are read as a single stream, and ones without content are skipped.
+class decompress_streambuf: public std::streambuf {
+   public:
+	static constexpr std::size_t DefaultBufferSize = 64 * 1024;
+
+	// Implemented for each codec.
+	class decoder;
+
+	// Throws `std::system_error` if the codec is not supported.
+	decompress_streambuf(std::streambuf* src, codec c, std::size_t buffer_size = DefaultBufferSize);
+
+	decompress_streambuf(decompress_streambuf const& other) = delete;
+
+	~decompress_streambuf();
+
+	decompress_streambuf& operator=(decompress_streambuf const& other) = delete;
+
+   protected:
+	// Throws `std::system_error` if the compressed stream is corrupted,
+	// or if it is truncated, i.e. the source ends within a member or a frame.
+	int_type underflow() override;
+
+   private:
+	std::streambuf* src_;
+
+	std::unique_ptr<decoder> decoder_;
+
+	std::vector<char> in_;
+	std::vector<char> out_;
+
+	std::size_t in_begin_ = 0;  // Of bytes in `in_` not decoded yet.
+	std::size_t in_end_   = 0;
+};
+
+// Tells the codec of a compressed stream by its leading bytes.
+// Returns `std::nullopt` if it is not known.
+std::optional<codec> detect_codec(std::span<char const> head);
+
+}  // namespace tar
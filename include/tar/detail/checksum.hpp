@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace tar {
+namespace detail {
+
+std::size_t constexpr SumBlockSize = 512;
+
+// Sums `SumBlockSize` bytes at `p` as unsigned.
+// Uses the widest vector instructions the CPU supports.
+std::uint32_t sum_block(void const* p) noexcept;
+
+std::uint32_t sum_block_scalar(void const* p) noexcept;
+
+#if defined(__x86_64__) || defined(__i386__)
+std::uint32_t sum_block_sse2(void const* p) noexcept;
+std::uint32_t sum_block_avx2(void const* p) noexcept;
+
+bool has_avx2() noexcept;
+#endif
+
+}  // namespace detail
+}  // namespace tar
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace tar {
+namespace detail {
+
+// Throws `std::system_error` made from `errno`.
+[[noreturn]] void throw_errno();
+
+// Owns a file descriptor.
+class unique_fd {
+   public:
+	unique_fd() = default;
+
+	// Throws `std::system_error` made from `errno` if `fd` is negative
+	// so the result of `open` can be passed directly.
+	explicit unique_fd(int fd);
+
+	unique_fd(unique_fd const& other) = delete;
+	unique_fd(unique_fd&& other)
+	    : fd_(std::exchange(other.fd_, -1)) { }
+
+	~unique_fd();
+
+	unique_fd& operator=(unique_fd const& other) = delete;
+	unique_fd& operator=(unique_fd&& other) {
+		std::swap(this->fd_, other.fd_);
+		return *this;
+	}
+
+	int get() const {
+		return this->fd_;
+	}
+
+	explicit operator bool() const {
+		return this->fd_ >= 0;
+	}
+
+   private:
+	int fd_ = -1;
+};
+
+// Reads until `n` bytes are read or the end of file is reached.
+// Returns the number of bytes read.
+std::size_t read_full(int fd, char* buf, std::size_t n);
+
+// Same as `read_full` but reads from given offset.
+std::size_t pread_full(int fd, char* buf, std::size_t n, std::uint64_t offset);
+
+void write_full(int fd, char const* buf, std::size_t n);
+
+void pwrite_full(int fd, char const* buf, std::size_t n, std::uint64_t offset);
+
+}  // namespace detail
+}  // namespace tar
@@ -1,14 +1,15 @@
 #pragma once
 
+#include <array>
 #include <concepts>
 #include <cstddef>
 #include <cstdint>
 #include <filesystem>
+#include <limits>
 #include <string>
 #include <system_error>
 #include <tuple>
-
-#include "tar/detail/string.hpp"
+#include <type_traits>
 
 namespace tar {
 namespace detail {
@@ -35,22 +36,136 @@ void unmarshal(std::array<char, N> const& dst, std::string& v) {
 	}
 }
 
+// Writes `v` in octal to `dst[0, w)`, padded with leading '0'.
+// If `v` needs more than `w` digits, only its leading `w` digits are written.
+// Negative values are written as their unsigned counterpart.
+template<std::integral T>
+constexpr void to_octal(T v, char* dst, std::size_t w) noexcept {
+	if(w == 0) [[unlikely]] {
+		return;
+	}
+
+	using U = std::make_unsigned_t<T>;
+
+	auto        u = static_cast<U>(v);
+	std::size_t n = 1;
+	for(U t = u >> 3; t != 0; t >>= 3) {
+		++n;
+	}
+	if(n > w) [[unlikely]] {
+		u >>= 3 * (n - w);
+	}
+
+	for(std::size_t i = w; i > 0; --i) {
+		dst[i - 1] = static_cast<char>('0' + (u & 7));
+		u >>= 3;
+	}
+}
+
+// Reads an octal number from `src[0, n)` after leading spaces, up to the first character that is not an octal digit.
+// Returns 0 if there is no digit or the number does not fit in `std::uintmax_t`.
+constexpr std::uintmax_t from_octal(char const* src, std::size_t n) noexcept {
+	std::size_t i = 0;
+	while(i < n && src[i] == ' ') {
+		++i;
+	}
+
+	std::uintmax_t v = 0;
+	for(; i < n; ++i) {
+		auto const c = src[i];
+		if(c < '0' || c > '7') {
+			break;
+		}
+		if(v > (std::numeric_limits<std::uintmax_t>::max() >> 3)) [[unlikely]] {
+			return 0;
+		}
+
+		v = (v << 3) | static_cast<std::uintmax_t>(c - '0');
+	}
+
+	return v;
+}
+
+// Writes `v` in GNU base-256 to `dst[0, n)`; the first byte is 0x80, or 0xFF if `v` is negative,
+// followed by the value in big-endian two's complement.
+// If `v` does not fit, only its trailing bytes are written.
+template<std::integral T>
+constexpr void to_base256(T v, char* dst, std::size_t n) noexcept {
+	if(n == 0) [[unlikely]] {
+		return;
+	}
+
+	using W = std::conditional_t<std::is_signed_v<T>, std::intmax_t, std::uintmax_t>;
+
+	auto w = static_cast<W>(v);
+	for(std::size_t i = n; i > 1; --i) {
+		dst[i - 1] = static_cast<char>(w & 0xFF);
+		w >>= 8;
+	}
+
+	dst[0] = static_cast<char>(v < 0 ? 0xFF : 0x80);
+}
+
+// Reads a GNU base-256 number from `src[0, n)`.
+// Negative values are returned as their unsigned counterpart.
+constexpr std::uintmax_t from_base256(char const* src, std::size_t n) noexcept {
+	if(n == 0) [[unlikely]] {
+		return 0;
+	}
+
+	auto const first = static_cast<std::uint8_t>(src[0]);
+
+	// Bit 6 of the first byte is the sign and the rest are the leading bits of the value.
+	std::uintmax_t v = (first & 0x40) ? ~std::uintmax_t(0x3F) : 0;
+	v |= first & 0x3F;
+	for(std::size_t i = 1; i < n; ++i) {
+		v = (v << 8) | static_cast<std::uint8_t>(src[i]);
+	}
+
+	return v;
+}
+
+// Tests if `src` holds a number in GNU base-256 rather than in octal.
+constexpr bool is_base256(char const* src) noexcept {
+	return (static_cast<std::uint8_t>(src[0]) & 0x80) != 0;
+}
+
+// Writes `v` in octal with `w` digits if it fits, or in base-256 over the whole `dst` otherwise
+// as GNU tar does for sizes of 8 GiB or more and times before the epoch.
 template<std::integral T, std::size_t N>
-void marshal(T v, std::array<char, N>& dst, std::size_t w = N - 1) {
-	detail::to_octal_string(v, w)
-	    .copy(reinterpret_cast<char*>(dst.data()), w);
+constexpr void marshal(T v, std::array<char, N>& dst, std::size_t w = N - 1) noexcept {
+	using U = std::make_unsigned_t<T>;
+
+	bool fits = v >= 0;
+	if(fits && w < std::numeric_limits<U>::digits / 3 + 1) {
+		fits = (static_cast<U>(v) >> (3 * w)) == 0;
+	}
+	if(fits) [[likely]] {
+		to_octal(v, dst.data(), w);
+	} else {
+		to_base256(v, dst.data(), N);
+	}
 }
 
 template<std::integral T, std::size_t N>
-void unmarshal(std::array<char, N> const& dst, T& v) {
-	std::string s;
-	unmarshal(dst, s);
+constexpr void unmarshal(std::array<char, N> const& dst, T& v) noexcept {
+	if(is_base256(dst.data())) [[unlikely]] {
+		v = static_cast<T>(from_base256(dst.data(), N));
+	} else {
+		v = static_cast<T>(from_octal(dst.data(), N));
+	}
+}
 
-	try {
-		v = s.empty() ? 0 : std::stoul(s, 0, 8);
-	} catch(...) {
-		v = 0;
+// Reads the size field of a header.
+// Returns false if it is negative, which only base-256 can tell.
+template<std::size_t N>
+constexpr bool unmarshal_size(std::array<char, N> const& src, std::uintmax_t& v) noexcept {
+	if(is_base256(src.data()) && (static_cast<std::uint8_t>(src[0]) & 0x40) != 0) [[unlikely]] {
+		return false;
 	}
+
+	unmarshal(src, v);
+	return true;
 }
 
 // Splits given path into two parts N and P by '/'.
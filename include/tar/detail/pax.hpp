@@ -0,0 +1,68 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "tar/ustar.hpp"
+
+namespace tar {
+namespace detail {
+
+// Extended headers larger than this are taken as corrupted.
+std::size_t constexpr MaxPaxSize = 1024 * 1024;
+
+// Calls `f(key, value)` for each record of a PAX extended header, formatted as "<length> <key>=<value>\n".
+// Returns false if the records are malformed.
+template<typename F>
+bool for_each_pax_record(std::string_view records, F&& f) {
+	while(!records.empty()) {
+		std::size_t n      = 0;
+		auto const* const end = records.data() + records.size();
+		auto const [p, ec]    = std::from_chars(records.data(), end, n);
+		if(ec != std::errc() || p == end || *p != ' ') [[unlikely]] {
+			return false;
+		}
+
+		auto const begin = static_cast<std::size_t>(p - records.data()) + 1;
+		if(n <= begin || n > records.size() || records[n - 1] != '\n') [[unlikely]] {
+			return false;
+		}
+
+		auto const record = records.substr(begin, n - begin - 1);
+		auto const eq     = record.find('=');
+		if(eq == std::string_view::npos) [[unlikely]] {
+			return false;
+		}
+
+		f(record.substr(0, eq), record.substr(eq + 1));
+		records.remove_prefix(n);
+	}
+
+	return true;
+}
+
+// Records of a PAX extended header describing the entry beyond the numeric fields of its header:
+// its path, and whether it is a sparse file of PAX format 1.0 of GNU tar.
+struct pax_entry {
+	std::string    path;  // Empty if not given.
+	bool           sparse    = false;
+	std::uintmax_t real_size = 0;  // Given by "GNU.sparse.realsize"; meaningful only if `sparse`.
+};
+
+// Reads "path", "GNU.sparse.name", "GNU.sparse.major", and "GNU.sparse.realsize" records.
+// The records are expected to be validated already, e.g. by `apply_pax`.
+pax_entry read_pax_entry(std::string_view records);
+
+// Formats a record of a PAX extended header.
+std::string pax_record(std::string_view key, std::string_view value);
+
+// Overrides numeric fields of `h` (size, uid, gid, mtime) by records of a PAX extended header.
+// Records of other keys are ignored and the checksum is left as it is.
+// Returns false if the records are malformed.
+bool apply_pax(std::string_view records, ustar::header& h);
+
+}  // namespace detail
+}  // namespace tar
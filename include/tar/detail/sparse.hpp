@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "tar/types.hpp"
+
+namespace tar {
+namespace detail {
+
+// Returns the regions of data in the file `fd` of `size` bytes, found by `lseek` with `SEEK_DATA` and `SEEK_HOLE`.
+// A file without holes, or on a file system that does not report them, is a single extent.
+// If the file ends with a hole, a zero-length extent at `size` marks the end as GNU tar does.
+// The file offset is rewound to the beginning.
+std::vector<extent> data_extents(int fd, std::uintmax_t size);
+
+// Returns the total size of data in given extents.
+std::uintmax_t data_size(std::span<extent const> extents);
+
+// Formats the sparse map of PAX format 1.0 (GNU.sparse.major=1, GNU.sparse.minor=0),
+// padded with NUL to a multiple of `ustar::BlockSize`.
+std::string format_sparse_map(std::span<extent const> extents);
+
+// Parses the sparse map at the beginning of `data` into `extents`.
+// Returns the number of bytes the map occupies including its padding, or 0 if `data` does not hold all of it yet.
+// Throws `std::system_error` if the map is malformed.
+std::size_t parse_sparse_map(std::string_view data, std::vector<extent>& extents);
+
+}  // namespace detail
+}  // namespace tar
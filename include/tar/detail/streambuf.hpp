@@ -1,8 +1,11 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
 #include <ios>
 #include <streambuf>
 #include <string>
+#include <vector>
 
 namespace tar {
 namespace detail {
@@ -121,5 +124,218 @@ class basic_scoped_streambuf: public basic_streambuf_wrapper<CharT, Traits> {
 
 using scoped_streambuf = basic_scoped_streambuf<std::streambuf::char_type>;
 
+// Reads a bounded area of the base through its own buffer.
+// Unlike `basic_scoped_streambuf`, it does not query the position of the base on every read;
+// the base is seeked only by `reset` and explicit seeks.
+template<class CharT, class Traits = std::char_traits<CharT>>
+class basic_bounded_streambuf: public basic_streambuf_wrapper<CharT, Traits> {
+   public:
+	using streambuf_type = std::basic_streambuf<CharT, Traits>;
+	using typename streambuf_type::char_type;
+	using typename streambuf_type::traits_type;
+	using typename streambuf_type::int_type;
+	using typename streambuf_type::pos_type;
+	using typename streambuf_type::off_type;
+
+	static constexpr std::size_t DefaultBufferSize = 64 * 1024;
+
+	basic_bounded_streambuf(std::basic_streambuf<CharT, Traits>* base, std::size_t buffer_size = DefaultBufferSize)
+	    : basic_streambuf_wrapper<CharT, Traits>(base)
+	    , buf_(buffer_size) {
+		this->setg(this->buf_.data(), this->buf_.data(), this->buf_.data());
+	}
+
+	basic_bounded_streambuf(basic_bounded_streambuf const& other) = delete;
+	basic_bounded_streambuf(basic_bounded_streambuf&& other)      = default;
+
+	// Limits the readable area to [begin, end) of the base.
+	void reset(pos_type begin, pos_type end) {
+		this->setg(this->buf_.data(), this->buf_.data(), this->buf_.data());
+		this->pos_ = begin;
+		this->end_ = end;
+
+		this->base_->pubseekpos(begin, std::ios_base::in);
+	}
+
+	// Same as `reset` but reaches `begin` by reading and discarding characters from the base
+	// instead of seeking so it works on non-seekable bases such as pipes.
+	// Positions are counted from where the base was when this streambuf was constructed
+	// and `begin` must not be behind the current position.
+	void forward(pos_type begin, pos_type end) {
+		// Characters left in the get area are discarded along with it.
+		this->setg(this->buf_.data(), this->buf_.data(), this->buf_.data());
+
+		this->end_ = begin;
+		while(this->fill_(this->buf_.data(), static_cast<std::streamsize>(this->buf_.size())) > 0) { }
+		this->end_ = end;
+	}
+
+	// Number of characters left in the area.
+	off_type remaining() const {
+		return (this->end_ - this->pos_) + (this->egptr() - this->gptr());
+	}
+
+   protected:
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override {
+		auto const cur = this->pos_ - static_cast<off_type>(this->egptr() - this->gptr());
+		switch(dir) {
+		case std::ios_base::cur:
+			if(off == 0) {
+				return cur;
+			}
+			return this->seekpos(cur + off, which);
+		case std::ios_base::end:
+			return this->seekpos(this->end_ + off, which);
+		default:
+			return this->seekpos(pos_type(off), which);
+		}
+	}
+
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override {
+		if(!(which & std::ios_base::in) || (this->end_ < pos)) [[unlikely]] {
+			return pos_type(off_type(-1));
+		}
+		if(this->base_->pubseekpos(pos, std::ios_base::in) != pos) [[unlikely]] {
+			return pos_type(off_type(-1));
+		}
+
+		this->setg(this->buf_.data(), this->buf_.data(), this->buf_.data());
+		this->pos_ = pos;
+		return pos;
+	}
+
+	std::streamsize showmanyc() override {
+		if(auto const n = this->end_ - this->pos_; n > 0) {
+			return n;
+		}
+		return -1;
+	}
+
+	int_type underflow() override {
+		if(this->gptr() < this->egptr()) {
+			return traits_type::to_int_type(*this->gptr());
+		}
+
+		auto const n = this->fill_(this->buf_.data(), static_cast<std::streamsize>(this->buf_.size()));
+		this->setg(this->buf_.data(), this->buf_.data(), this->buf_.data() + n);
+		if(n == 0) [[unlikely]] {
+			return traits_type::eof();
+		}
+
+		return traits_type::to_int_type(*this->gptr());
+	}
+
+	int_type uflow() override {
+		auto const c = this->underflow();
+		if(!traits_type::eq_int_type(c, traits_type::eof())) [[likely]] {
+			this->gbump(1);
+		}
+
+		return c;
+	}
+
+	std::streamsize xsgetn(char_type* s, std::streamsize count) override {
+		std::streamsize n = 0;
+		while(n < count) {
+			if(auto const avail = this->egptr() - this->gptr(); avail > 0) {
+				auto const l = std::min<std::streamsize>(avail, count - n);
+				traits_type::copy(s + n, this->gptr(), l);
+				this->gbump(static_cast<int>(l));
+				n += l;
+				continue;
+			}
+
+			// Reads that would drain the buffer anyway go directly to the destination.
+			if(auto const rest = count - n; (rest >= static_cast<std::streamsize>(this->buf_.size())) || (rest >= this->end_ - this->pos_)) {
+				auto const l = this->fill_(s + n, rest);
+				if(l == 0) [[unlikely]] {
+					break;
+				}
+				n += l;
+				continue;
+			}
+
+			if(traits_type::eq_int_type(this->underflow(), traits_type::eof())) [[unlikely]] {
+				break;
+			}
+		}
+
+		return n;
+	}
+
+   private:
+	// Reads at most `count` characters from the base but not beyond the end of the area.
+	std::streamsize fill_(char_type* s, std::streamsize count) {
+		if(off_type const remain = this->end_ - this->pos_; remain < count) {
+			count = remain;
+		}
+		if(count <= 0) [[unlikely]] {
+			return 0;
+		}
+
+		auto const n = this->base_->sgetn(s, count);
+		this->pos_ += n;
+		return n;
+	}
+
+	std::vector<char_type> buf_;
+
+	pos_type pos_ = 0;  // Position of the base that `egptr()` corresponds to.
+	pos_type end_ = 0;
+};
+
+using bounded_streambuf = basic_bounded_streambuf<std::streambuf::char_type>;
+
+// Counts characters put to the base.
+template<class CharT, class Traits = std::char_traits<CharT>>
+class basic_counting_streambuf: public basic_streambuf_wrapper<CharT, Traits> {
+   public:
+	using streambuf_type = std::basic_streambuf<CharT, Traits>;
+	using typename streambuf_type::char_type;
+	using typename streambuf_type::traits_type;
+	using typename streambuf_type::int_type;
+	using typename streambuf_type::pos_type;
+	using typename streambuf_type::off_type;
+
+	basic_counting_streambuf(std::basic_streambuf<CharT, Traits>* base)
+	    : basic_streambuf_wrapper<CharT, Traits>(base) { }
+
+	// Number of characters put so far; seeks do not affect it.
+	std::streamsize count() const {
+		return this->count_;
+	}
+
+	// Counts characters put to the base without going through this streambuf.
+	void bypassed(std::streamsize n) {
+		this->count_ += n;
+	}
+
+   protected:
+	int_type overflow(int_type ch = Traits::eof()) override {
+		if(traits_type::eq_int_type(ch, traits_type::eof())) [[unlikely]] {
+			return traits_type::not_eof(ch);
+		}
+
+		auto const ret = this->base_->sputc(traits_type::to_char_type(ch));
+		if(!traits_type::eq_int_type(ret, traits_type::eof())) [[likely]] {
+			++this->count_;
+		}
+
+		return ret;
+	}
+
+	std::streamsize xsputn(const char_type* s, std::streamsize count) override {
+		auto const n = this->base_->sputn(s, count);
+		this->count_ += n;
+
+		return n;
+	}
+
+   private:
+	std::streamsize count_ = 0;
+};
+
+using counting_streambuf = basic_counting_streambuf<std::streambuf::char_type>;
+
 }  // namespace detail
 }  // namespace tar
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <ios>
+#include <istream>
+#include <iterator>
+#include <ranges>
+
+#include "tar/types.hpp"
+#include "tar/ustar.hpp"
+
+namespace tar {
+namespace ustar {
+
+// Entry given by `entries`; fields are decoded from the header only when they are asked for.
+class entry {
+   public:
+	ustar::header const& raw() const {
+		return this->h_;
+	}
+
+	header_view view() const {
+		return header_view(this->h_);
+	}
+
+	file_type type() const {
+		return this->h_.typeflag;
+	}
+
+	std::uintmax_t size() const {
+		return this->view().size();
+	}
+
+	// The one given by a PAX extended header if any; see `istream::pax_path`.
+	std::filesystem::path path() const;
+
+	// Decodes all the fields, with the path as `path` gives.
+	tar::header header() const;
+
+	// Stream reading the body; valid until the next entry is taken.
+	std::istream& body() const {
+		return *this->i_;
+	}
+
+	// Position of the header; see `istream::header_offset`.
+	std::streampos offset() const {
+		return this->offset_;
+	}
+
+   private:
+	friend class entry_range;
+
+	istream*       i_ = nullptr;
+	ustar::header  h_;
+	std::streampos offset_;
+};
+
+// Input range of the entries of an archive read by `i`.
+// Taking the next entry skips the body of the current one without reading it if `i` is seekable,
+// otherwise by reading past it, so entries dropped by e.g. `std::views::filter` cost only their headers.
+// The range ends at the end of the archive or on an error, which is left in the state of `i`.
+class entry_range: public std::ranges::view_interface<entry_range> {
+   public:
+	class iterator {
+	   public:
+		using iterator_concept = std::input_iterator_tag;
+		using value_type       = entry;
+		using difference_type  = std::ptrdiff_t;
+
+		iterator() = default;
+
+		entry const& operator*() const {
+			return this->r_->entry_;
+		}
+
+		entry const* operator->() const {
+			return &this->r_->entry_;
+		}
+
+		iterator& operator++() {
+			this->r_->advance_();
+			return *this;
+		}
+
+		void operator++(int) {
+			++*this;
+		}
+
+		bool operator==(std::default_sentinel_t) const {
+			return this->r_ == nullptr || this->r_->done_;
+		}
+
+	   private:
+		friend class entry_range;
+
+		explicit iterator(entry_range* r)
+		    : r_(r) { }
+
+		entry_range* r_ = nullptr;
+	};
+
+	explicit entry_range(istream& i);
+
+	// Takes the first entry; a range can be iterated only once.
+	iterator begin();
+
+	std::default_sentinel_t end() const {
+		return std::default_sentinel;
+	}
+
+   private:
+	void advance_();
+
+	entry entry_;
+	bool  started_ = false;
+	bool  done_    = false;
+};
+
+inline entry_range entries(istream& i) {
+	return entry_range(i);
+}
+
+}  // namespace ustar
+}  // namespace tar
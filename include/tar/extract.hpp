@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+namespace tar {
+
+class pattern_set;
+
+namespace ustar {
+
+struct extract_options {
+	// Number of threads writing bodies; 0 to use all hardware threads.
+	std::size_t threads = 0;
+
+	// Bodies larger than this, except ones of sparse files, are split to be written by several threads.
+	std::size_t chunk_size = 64 * 1024 * 1024;
+
+	// Entries whose path is not selected are skipped; all are extracted if null.
+	// A hard link to a skipped file fails to be created.
+	pattern_set const* patterns = nullptr;
+};
+
+// Extracts the archive at `src` into the directory `dst`.
+// Regular files are created and written concurrently with positional reads from the archive.
+// Hard links and symbolic links are created after all regular files are written,
+// and permissions and modification time of directories are applied after all of their children.
+// Sparse files are recreated with holes, so only their data are written.
+// Entries with an absolute path are extracted relative to `dst`, and ones escaping `dst` by ".." are rejected.
+// Paths are resolved beneath `dst` without following symbolic links, whether extracted or already there,
+// so an entry or a hard link source under a symbolic link is rejected rather than written through it.
+void extract(std::filesystem::path const& src, std::filesystem::path const& dst, extract_options const& options = {});
+
+}  // namespace ustar
+}  // namespace tar
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ios>
+#include <streambuf>
+#include <vector>
+
+namespace tar {
+
+// Stream buffer over a file descriptor.
+// The file descriptor is not owned; it must outlive the buffer.
+class fdbuf: public std::streambuf {
+   public:
+	static constexpr std::size_t DefaultBufferSize = 64 * 1024;
+
+	fdbuf(int fd, std::size_t buffer_size = DefaultBufferSize);
+
+	~fdbuf();
+
+	int fd() const {
+		return this->fd_;
+	}
+
+	// Writes `n` bytes read from `in` at its current offset, moved by the kernel
+	// with `copy_file_range` or `sendfile` so they never reach the user space.
+	// Returns the number of bytes written, which is less than `n` if `in` reaches its end
+	// or the kernel cannot move bytes between the two.
+	std::uintmax_t transfer_from(int in, std::uintmax_t n);
+
+   protected:
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override;
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override;
+
+	int sync() override;
+
+	int_type underflow() override;
+
+	int_type        overflow(int_type ch = traits_type::eof()) override;
+	std::streamsize xsputn(char_type const* s, std::streamsize count) override;
+
+   private:
+	// Writes the put area to the file.
+	bool flush_();
+
+	// Drops the get area and moves the file offset back to the first character not read.
+	bool unread_();
+
+	int fd_;
+
+	std::vector<char_type> in_;
+	std::vector<char_type> out_;
+};
+
+}  // namespace tar
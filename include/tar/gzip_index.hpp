@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ios>
+#include <memory>
+#include <span>
+#include <streambuf>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "tar/ustar.hpp"
+
+namespace tar {
+namespace ustar {
+
+// Index of an existing gzip-compressed archive, e.g. one made by `tar czf`, to read it from any entry.
+// It is built by a single pass which saves the state of inflate at deflate block boundaries
+// every `span` bytes of output (a checkpoint), along with where the header of each entry is in the output.
+// Reading an entry then inflates from the last checkpoint before it rather than from the beginning.
+class gzip_index {
+   public:
+	static constexpr std::uint64_t DefaultSpan = 16 * 1024 * 1024;
+	static constexpr std::size_t   WindowSize  = 32 * 1024;
+
+	struct checkpoint {
+		std::uint64_t in;    // Offset in the compressed stream of the first byte not wholly consumed.
+		std::uint64_t out;   // Offset in the uncompressed stream.
+		std::uint8_t  bits;  // Number of bits of the byte before `in` not consumed yet.
+
+		std::uint64_t window_offset;  // Offset of the last (up to) `WindowSize` bytes of output before `out` in the window table.
+		std::uint32_t window_size;
+	};
+
+	struct entry {
+		std::uint64_t offset;  // Of the header in the uncompressed stream.
+
+		std::uint32_t path_offset;  // Offset of the path in the path table.
+		std::uint32_t path_size;
+	};
+
+	// Builds the index of the archive in `src` from its current position.
+	// `src` must be seekable to open entries later.
+	// Throws `std::system_error` if the stream is not gzip or is corrupted.
+	gzip_index(std::streambuf* src, std::uint64_t span = DefaultSpan);
+
+	gzip_index(gzip_index const& other) = delete;
+	gzip_index(gzip_index&& other)      = default;
+
+	gzip_index& operator=(gzip_index const& other) = delete;
+	gzip_index& operator=(gzip_index&& other)      = default;
+
+	// Reads an index written by `save` for the archive in `src`, which is positioned as it was when the index was built.
+	// Throws `std::system_error` if the index is malformed or the archive differs in size from the indexed one.
+	static gzip_index load(std::streambuf* src, std::streambuf* saved);
+
+	void save(std::streambuf* dst) const;
+
+	std::span<checkpoint const> checkpoints() const {
+		return this->checkpoints_;
+	}
+
+	std::span<entry const> entries() const {
+		return this->entries_;
+	}
+
+	std::span<char const> window(checkpoint const& c) const {
+		return std::span<char const>(this->windows_.data() + c.window_offset, c.window_size);
+	}
+
+	std::string_view path(entry const& e) const {
+		return std::string_view(this->paths_.data() + e.path_offset, e.path_size);
+	}
+
+	// Returns the last entry with given path or `nullptr` if there is no such entry.
+	entry const* find(std::string_view path) const;
+
+	// Returns a stream reading the archive from given entry, so its first `next` gives the entry.
+	// Streams share the source so only one of them can be read at a time.
+	std::unique_ptr<istream> open(entry const& e) const;
+
+	// Throws `std::system_error` if there is no entry with given path.
+	std::unique_ptr<istream> open(std::string_view path) const;
+
+   private:
+	gzip_index() = default;
+
+	void index_paths_();
+
+	std::streambuf* src_  = nullptr;
+	std::streamoff  base_ = -1;  // Position of the archive in `src_`.
+	std::uint64_t   size_ = 0;   // Of the compressed stream.
+
+	std::vector<checkpoint> checkpoints_;
+	std::vector<char>       windows_;
+	std::vector<entry>      entries_;
+	std::vector<char>       paths_;
+
+	std::unordered_map<std::string_view, std::size_t> lookup_;
+};
+
+}  // namespace ustar
+}  // namespace tar
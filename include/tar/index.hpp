@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <span>
+#include <streambuf>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "tar/detail/streambuf.hpp"
+#include "tar/types.hpp"
+
+namespace tar {
+namespace ustar {
+
+// Input stream over the body of a single entry.
+class body_istream: public std::istream {
+   public:
+	body_istream(std::streambuf* buf, pos_type begin, pos_type end);
+	body_istream(body_istream&& other);
+
+   private:
+	detail::bounded_streambuf buf_;
+};
+
+// Table of the entries in an archive, built by a single pass over its headers.
+// Bodies are never read while building it, except ones of PAX extended headers
+// whose records of size, path and sparse files (PAX format 1.0 of GNU tar) are applied to the next entry.
+class index {
+   public:
+	struct entry {
+		std::uint64_t header_offset;
+		std::uint64_t body_offset;
+		std::uint64_t size;
+		std::uint64_t real_size;  // Size of the file; differs from `size` if `sparse`.
+
+		std::uint32_t path_offset;  // Offset of the path in the path table.
+		std::uint32_t path_size;
+
+		tar::file_type type;
+
+		// Whether the body is a sparse map followed by the data, which `open` hands out as they are.
+		bool sparse;
+	};
+
+	// Scans the archive from the current position of `buf`.
+	// Throws `std::system_error` if `verify_checksum` is set and a header does not match its checksum.
+	index(std::streambuf* buf, bool verify_checksum = true);
+
+	index(index const& other) = delete;
+	index(index&& other)      = default;
+
+	index& operator=(index const& other) = delete;
+	index& operator=(index&& other)      = default;
+
+	std::span<entry const> entries() const {
+		return this->entries_;
+	}
+
+	std::size_t size() const {
+		return this->entries_.size();
+	}
+
+	std::string_view path(entry const& e) const {
+		return std::string_view(this->paths_.data() + e.path_offset, e.path_size);
+	}
+
+	// Returns the last entry with given path or `nullptr` if there is no such entry.
+	entry const* find(std::string_view path) const;
+
+	body_istream open(entry const& e) const;
+
+	// Throws `std::system_error` if there is no entry with given path.
+	body_istream open(std::string_view path) const;
+
+   private:
+	std::streambuf* buf_;
+
+	std::vector<entry> entries_;
+	std::vector<char>  paths_;
+
+	std::unordered_map<std::string_view, std::size_t> lookup_;
+};
+
+}  // namespace ustar
+}  // namespace tar
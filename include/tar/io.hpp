@@ -1,12 +1,28 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
 #include <iosfwd>
+#include <memory>
+#include <ostream>
+#include <span>
 
+#include "tar/links.hpp"
+#include "tar/names.hpp"
 #include "tar/types.hpp"
 
 namespace tar {
 
+// Makes a header describing the file at `p` without following it if it is a symbolic link.
+// The path in the header is `as` unless it is empty.
+header header_of(std::filesystem::path const& p, std::filesystem::path const& as = "");
+
+// Same as above but user and group names are resolved through `names`.
+header header_of(std::filesystem::path const& p, std::filesystem::path const& as, name_cache& names);
+
+// Same as above and gives the identity of the file in `id`.
+header header_of(std::filesystem::path const& p, std::filesystem::path const& as, name_cache& names, file_id& id);
+
 class istream: public std::istream {
    public:
 	virtual istream& next(header& header) = 0;
@@ -18,7 +34,74 @@ class ostream: public std::ostream {
 
 	virtual ostream& next(header const& header) = 0;
 
+	// Starts an entry whose body is exactly `size` characters long.
+	// Unlike `next(header)`, the header is written once and the stream is never seeked back.
+	// By default the entry is started by `next(header)`, so formats not overriding it take the size from the body.
+	virtual ostream& next(header const& header, std::uintmax_t) {
+		return this->next(header);
+	}
+
+	// Starts an entry of a sparse file of `header.size` bytes which holds data only in `extents`.
+	// Data of the extents are to be written in order as the body, e.g. by `write_from(fd, extents)`.
+	// Returns false without starting an entry if the format does not support sparse files.
+	virtual bool next_sparse(header const& /* header */, std::span<extent const> /* extents */) {
+		return false;
+	}
+
+	// Regular files with holes are written as sparse files if the format supports them.
+	// Files with more than one link are written as hard links to the first entry written for them through `links()`.
 	ostream& next(std::filesystem::path const& p, std::filesystem::path const& as = "");
+
+	// Starts an entry of a hard link to the first entry written for the file of `id` and returns true if there is one
+	// and the format can refer to its path. Otherwise, `h` is remembered for the file if it is the first one,
+	// and false is returned without starting an entry so the file is to be written in full.
+	// Directories are never linked.
+	bool next_link(header const& h, file_id const& id);
+
+	// Writes `n` bytes read from `fd` at its current offset.
+	// Bytes are moved by the kernel without being copied through the stream if the destination allows it.
+	// Returns the number of bytes written, which is less than `n` only if `fd` reaches its end.
+	std::uintmax_t write_from(int fd, std::uintmax_t n);
+
+	// Writes data of given extents of `fd` in order.
+	// Returns the number of bytes written, which is less than the total size of the extents only if `fd` reaches its end.
+	std::uintmax_t write_from(int fd, std::span<extent const> extents);
+
+	// Cache used to resolve user and group names of files written by `next(path)`.
+	// Each stream has its own by default; it can be shared among streams.
+	std::shared_ptr<name_cache> const& names() const {
+		return this->names_;
+	}
+
+	void names(std::shared_ptr<name_cache> names) {
+		this->names_ = std::move(names);
+	}
+
+	// Paths of entries written for files with more than one link.
+	// Each stream has its own by default; null disables writing hard links so every link is written in full.
+	std::shared_ptr<link_map> const& links() const {
+		return this->links_;
+	}
+
+	void links(std::shared_ptr<link_map> links) {
+		this->links_ = std::move(links);
+	}
+
+   protected:
+	// Tells if a hard link can refer to an entry of given path.
+	virtual bool can_link_to_(std::filesystem::path const&) const {
+		return true;
+	}
+
+	// Writes at most `n` bytes read from `fd` bypassing the stream.
+	// Returns the number of bytes written; 0 if the destination does not allow it.
+	virtual std::uintmax_t transfer_(int /* fd */, std::uintmax_t /* n */) {
+		return 0;
+	}
+
+   private:
+	std::shared_ptr<name_cache> names_ = std::make_shared<name_cache>();
+	std::shared_ptr<link_map>   links_ = std::make_shared<link_map>();
 };
 
 }  // namespace tar
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <unordered_map>
+
+#include "tar/types.hpp"
+
+namespace tar {
+
+// Remembers the path of the first entry written for each file with more than one link,
+// so the other links to it are written as hard links instead of with the same body again.
+// Entries must be given in the order they are written. It is not safe to use from several threads.
+class link_map {
+   public:
+	// Returns the path remembered for the file of `id`.
+	// Returns `nullptr` if there is none, remembering `p` for it if the file has more than one link.
+	std::filesystem::path const* find_or_insert(file_id const& id, std::filesystem::path const& p);
+
+	void clear() {
+		this->paths_.clear();
+	}
+
+   private:
+	struct key {
+		std::uintmax_t device;
+		std::uintmax_t inode;
+
+		bool operator==(key const& other) const = default;
+	};
+
+	struct hash {
+		std::size_t operator()(key const& k) const noexcept {
+			return std::hash<std::uintmax_t>{}(k.inode) ^ (std::hash<std::uintmax_t>{}(k.device) << 1);
+		}
+	};
+
+	std::unordered_map<key, std::filesystem::path, hash> paths_;
+};
+
+}  // namespace tar
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <string>
+
+#include "tar/ustar.hpp"
+
+namespace tar {
+namespace ustar {
+
+// Archive file mapped into memory.
+// Headers and bodies are handed out as views of the mapping so nothing is copied.
+// Headers are checked as `index` does, and PAX extended headers are not entries of their own:
+// their records are given with the entry they precede, whose size is taken from them,
+// but other fields of the raw header are left as they are; see `entry::path` for the path.
+class mapped_archive {
+   public:
+	// Expected pattern of access, passed to the kernel as a hint.
+	enum class access {
+		normal,
+		sequential,
+		random,
+	};
+
+	struct entry {
+		std::span<std::byte const, BlockSize> block;  // Raw header.
+		std::span<std::byte const>            body;
+
+		std::uint64_t offset;  // Offset of the header in the archive.
+
+		std::span<std::byte const> records;  // Of the PAX extended header preceding the header, if any.
+
+		ustar::header const& header() const {
+			return *reinterpret_cast<ustar::header const*>(this->block.data());
+		}
+
+		// Path given by the PAX extended header, e.g. the real one of a sparse file, or by the header.
+		std::string path() const;
+	};
+
+	class iterator {
+	   public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type        = entry;
+		using difference_type   = std::ptrdiff_t;
+		using pointer           = entry const*;
+		using reference         = entry const&;
+
+		iterator() = default;
+		iterator(mapped_archive const* archive, std::uint64_t offset);
+
+		reference operator*() const {
+			return *this->entry_;
+		}
+
+		pointer operator->() const {
+			return &*this->entry_;
+		}
+
+		iterator& operator++();
+
+		iterator operator++(int) {
+			auto it = *this;
+			++*this;
+			return it;
+		}
+
+		bool operator==(iterator const& other) const {
+			if(!this->entry_ || !other.entry_) {
+				return !this->entry_ && !other.entry_;
+			}
+
+			return (this->archive_ == other.archive_) && (this->entry_->offset == other.entry_->offset);
+		}
+
+	   private:
+		mapped_archive const* archive_ = nullptr;
+
+		std::optional<entry> entry_;  // Empty at the end.
+	};
+
+	mapped_archive(std::filesystem::path const& p, access hint = access::normal);
+
+	mapped_archive(mapped_archive const& other) = delete;
+	mapped_archive(mapped_archive&& other);
+
+	~mapped_archive();
+
+	mapped_archive& operator=(mapped_archive const& other) = delete;
+	mapped_archive& operator=(mapped_archive&& other);
+
+	std::span<std::byte const> data() const {
+		return std::span<std::byte const>(this->data_, this->size_);
+	}
+
+	iterator begin() const {
+		return iterator(this, 0);
+	}
+
+	iterator end() const {
+		return iterator();
+	}
+
+	// Returns the entry whose header, or PAX extended header preceding it, is at given offset,
+	// e.g. `index::entry::header_offset`. That one is of the header itself, so the records are not given.
+	// Throws `std::system_error` if the archive is malformed or truncated, or the offset is at the end of the archive.
+	entry at(std::uint64_t offset) const;
+
+	// Applies given hint to the whole archive.
+	void advise(access hint) const;
+
+	// Tells the kernel the body of given entry will be read soon.
+	void prefetch(entry const& e) const;
+
+   private:
+	std::optional<entry> try_at_(std::uint64_t offset) const;
+
+	std::byte const* data_ = nullptr;
+	std::size_t      size_ = 0;
+};
+
+}  // namespace ustar
+}  // namespace tar
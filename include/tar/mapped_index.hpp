@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+
+#include "tar/index.hpp"
+
+namespace tar {
+namespace ustar {
+
+// Index of an archive saved in a file next to it, which is mapped into memory and used as it is,
+// so reopening a large archive costs neither a scan of its headers nor any parsing.
+// Entries are kept in the order of the archive along with a table of them sorted by path for `find`.
+// The file records the size and modification time of the archive and is refused if they differ.
+class mapped_index {
+   public:
+	static constexpr std::uint32_t Version = 1;
+
+	// Writes `idx`, built from the archive at `archive`, to `p`.
+	// The file is written aside and renamed so readers never see it partially written.
+	static void write(index const& idx, std::filesystem::path const& archive, std::filesystem::path const& p);
+
+	// Maps the index at `p` of the archive at `archive`.
+	// Throws `std::system_error` if it cannot be read, is malformed, is of another version or layout,
+	// or the archive has changed since it was written.
+	mapped_index(std::filesystem::path const& p, std::filesystem::path const& archive);
+
+	// Maps the index at `p`, writing it first from a scan of `archive` if it is missing or cannot be used.
+	// The archive is scanned again if it changes during the scan;
+	// throws `std::system_error` if it keeps changing.
+	static mapped_index open_or_build(std::filesystem::path const& archive, std::filesystem::path const& p, bool verify_checksum = true);
+
+	mapped_index(mapped_index const& other) = delete;
+	mapped_index(mapped_index&& other);
+
+	~mapped_index();
+
+	mapped_index& operator=(mapped_index const& other) = delete;
+	mapped_index& operator=(mapped_index&& other);
+
+	std::span<index::entry const> entries() const {
+		return this->entries_;
+	}
+
+	std::size_t size() const {
+		return this->entries_.size();
+	}
+
+	// Throws `std::system_error` if the path lies outside of the path table.
+	std::string_view path(index::entry const& e) const;
+
+	// Returns the last entry with given path or `nullptr` if there is no such entry.
+	index::entry const* find(std::string_view path) const;
+
+   private:
+	std::byte const* data_ = nullptr;
+	std::size_t      size_ = 0;
+
+	std::span<index::entry const>  entries_;
+	std::span<std::uint32_t const> sorted_;  // Positions of `entries_` ordered by path.
+	std::string_view               paths_;
+};
+
+// Path of the index kept next to `archive`.
+inline std::filesystem::path sidecar_path(std::filesystem::path const& archive) {
+	auto p = archive;
+	p += ".index";
+	return p;
+}
+
+}  // namespace ustar
+}  // namespace tar
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+namespace tar {
+
+// Resolves user and group IDs to their names, asking the system at most once for each ID.
+// It is safe to use from several threads.
+class name_cache {
+   public:
+	using map_type = std::unordered_map<std::uintmax_t, std::string>;
+
+	name_cache() = default;
+
+	// Given names are used without asking the system.
+	name_cache(map_type users, map_type groups)
+	    : users_(std::move(users))
+	    , groups_(std::move(groups)) { }
+
+	// Returns an empty string if there is no such user.
+	// Returned reference stays valid as long as the cache does.
+	std::string const& user_name(std::uintmax_t uid);
+
+	// Returns an empty string if there is no such group.
+	// Returned reference stays valid as long as the cache does.
+	std::string const& group_name(std::uintmax_t gid);
+
+   private:
+	std::shared_mutex mutex_;
+
+	map_type users_;
+	map_type groups_;
+};
+
+}  // namespace tar
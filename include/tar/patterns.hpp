@@ -0,0 +1,109 @@
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "tar/ustar.hpp"
+
+namespace tar {
+
+// Set of include and exclude patterns that selects paths of entries.
+// A path is selected if it matches an include pattern, or there is none, and no exclude pattern.
+//
+// Patterns are anchored at the beginning of the path and match it as a whole or any of its leading directories,
+// so "usr/lib" and "usr/lib/" match "usr/lib/libc.so". In a pattern
+//   `*`  matches any characters except '/',
+//   `**` matches any characters; followed by '/' it matches any leading directories, including none,
+//   `?`  matches a character except '/',
+//   `[...]` matches a character in the class, negated by a leading '!' or '^', with ranges like "a-z",
+//   `\`  makes the following character literal.
+//
+// Literal prefixes of the patterns are compiled into a trie walked once for each path,
+// and only the rest of patterns whose prefix is met are run, one by one, as small automata,
+// so patterns sharing no prefix with the path cost nothing. Patterns starting with a wildcard, e.g. "*.log",
+// have an empty prefix and are run for every path, so their cost grows with their number.
+// Matching does not allocate; it is safe to match from several threads once the set is built.
+class pattern_set {
+   public:
+	// Largest number of elements of a pattern after its literal prefix.
+	static constexpr std::size_t MaxTailSize = 256;
+
+	// Throws `std::system_error` if the pattern is malformed or its tail is too long.
+	void include(std::string_view pattern) {
+		this->add_(pattern, false);
+	}
+
+	// Throws `std::system_error` if the pattern is malformed or its tail is too long.
+	void exclude(std::string_view pattern) {
+		this->add_(pattern, true);
+	}
+
+	bool empty() const {
+		return this->includes_ == 0 && this->excludes_ == 0;
+	}
+
+	bool selects(std::string_view path) const;
+
+	// Matches the path of the header, joined from its prefix and name without being copied.
+	// Paths given by PAX extended headers are not seen; use `selects(path)` with e.g. `istream::pax_path` for them.
+	bool selects(ustar::header_view const& h) const;
+
+   private:
+	class path_ref;
+
+	enum class op : std::uint8_t {
+		literal,
+		one,
+		set,
+		star,      // `*`
+		star_all,  // `**`
+		any_dirs,  // `**/`, followed by `in_dirs`.
+		in_dirs,   // Within directories matched by `**/`.
+	};
+
+	struct element {
+		op            kind;
+		char          c;
+		std::uint32_t set;  // Index of `sets_`.
+	};
+
+	struct tail {
+		std::uint32_t begin;  // Index of `elements_`.
+		std::uint32_t size;
+		std::uint32_t suffix;  // Number of literals ending the tail, checked before it is run.
+		bool          exclude;
+	};
+
+	struct node {
+		std::vector<std::pair<char, std::uint32_t>> children;  // Sorted by character.
+		std::vector<std::uint32_t>                  tails;
+
+		// Whether a pattern without wildcards ends here.
+		bool include = false;
+		bool exclude = false;
+	};
+
+	void add_(std::string_view pattern, bool exclude);
+
+	// Returns the node reached from `n` by `c`, or 0 if there is none; the root is never a child.
+	std::uint32_t child_(std::uint32_t n, char c) const;
+
+	// Tells if the tail matches `p` from `offset` as a whole or up to a '/'.
+	bool matches_(tail const& t, path_ref const& p, std::size_t offset) const;
+
+	bool selects_(path_ref const& p) const;
+
+	std::vector<node>             nodes_ = std::vector<node>(1);
+	std::vector<tail>             tails_;
+	std::vector<element>          elements_;
+	std::vector<std::bitset<256>> sets_;
+
+	std::size_t includes_ = 0;
+	std::size_t excludes_ = 0;
+};
+
+}  // namespace tar
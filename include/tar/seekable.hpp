@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "tar/compress.hpp"
+#include "tar/types.hpp"
+#include "tar/ustar.hpp"
+
+namespace tar {
+namespace detail {
+
+// Constructed before `ustar::seekable_ostream` and destroyed after it,
+// so the compressed stream outlives the archive written into it.
+class seekable_ostream_base {
+   protected:
+	seekable_ostream_base(std::streambuf* dst, compress_options const& options);
+
+	// Finishes the compressed stream and appends the seek table.
+	~seekable_ostream_base();
+
+	// Starts a new member (frame) for an entry of given path.
+	void start_entry_(std::string_view path);
+
+	std::streambuf*    dst_;
+	compress_streambuf compressor_;
+
+	std::uint64_t entry_count_ = 0;
+	std::string   entries_;  // Serialized entries of the seek table.
+};
+
+// Constructed before `ustar::seekable_archive`'s stream so it can skip to the entry before the stream reads.
+class seekable_istream_base {
+   protected:
+	seekable_istream_base(std::streambuf* src, codec c, std::uint64_t skip);
+
+	decompress_streambuf decompressor_;
+};
+
+}  // namespace detail
+
+namespace ustar {
+
+// Writes a compressed archive which can be read from any entry without decompressing ones before it.
+// Each entry starts a new gzip member (zstd frame), and a seek table of the entries and the members
+// is appended in members (skippable frames) without content, so the output still decompresses to a plain archive.
+// Entries are to be started with their size known, e.g. by `next(h, size)` or `next(path)`,
+// as the compressed stream cannot be seeked back to patch a header;
+// `next(h)` throws `std::system_error`.
+class seekable_ostream: private detail::seekable_ostream_base, public ostream {
+   public:
+	seekable_ostream(std::streambuf* dst, compress_options const& options = {});
+
+   protected:
+	void begin_entry_(std::string_view path, bool size_known) override;
+};
+
+// Seek table of an archive written by `seekable_ostream`.
+class seekable_archive {
+   public:
+	struct entry {
+		std::uint64_t offset;  // Of the header in the uncompressed stream.
+
+		std::uint32_t path_offset;  // Offset of the path in the path table.
+		std::uint32_t path_size;
+	};
+
+	// Reads the seek table at the end of `src`, which must be seekable and positioned at the beginning of the archive.
+	// Throws `std::system_error` if there is no seek table.
+	seekable_archive(std::streambuf* src);
+
+	seekable_archive(seekable_archive const& other) = delete;
+	seekable_archive(seekable_archive&& other)      = default;
+
+	seekable_archive& operator=(seekable_archive const& other) = delete;
+	seekable_archive& operator=(seekable_archive&& other)      = default;
+
+	tar::codec codec() const {
+		return this->codec_;
+	}
+
+	std::span<entry const> entries() const {
+		return this->entries_;
+	}
+
+	std::span<compressed_frame const> frames() const {
+		return this->frames_;
+	}
+
+	std::string_view path(entry const& e) const {
+		return std::string_view(this->paths_.data() + e.path_offset, e.path_size);
+	}
+
+	// Returns the last entry with given path or `nullptr` if there is no such entry.
+	entry const* find(std::string_view path) const;
+
+	// Returns a stream reading the archive from given entry, so its first `next` gives the entry.
+	// Only the member (frame) holding the entry and the following ones are decompressed.
+	// Streams share the source so only one of them can be read at a time.
+	std::unique_ptr<istream> open(entry const& e) const;
+
+	// Throws `std::system_error` if there is no entry with given path.
+	std::unique_ptr<istream> open(std::string_view path) const;
+
+   private:
+	std::streambuf* src_;
+	std::streamoff  base_;  // Position of the archive in `src_`.
+
+	tar::codec codec_;
+
+	std::vector<compressed_frame> frames_;
+	std::vector<entry>            entries_;
+	std::vector<char>             paths_;
+
+	std::unordered_map<std::string_view, std::size_t> lookup_;
+};
+
+}  // namespace ustar
+}  // namespace tar
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <ios>
+#include <istream>
+#include <memory>
+#include <span>
+#include <streambuf>
+#include <string_view>
+#include <vector>
+
+#include "tar/detail/fd.hpp"
+#include "tar/fdbuf.hpp"
+#include "tar/index.hpp"
+
+namespace tar {
+namespace ustar {
+
+// Stream buffer reading a range of a file with `pread`, so it has its own position
+// and any number of them can read the same file descriptor at once.
+// Positions are relative to the beginning of the range.
+class pread_streambuf: public std::streambuf {
+   public:
+	static constexpr std::size_t DefaultBufferSize = 64 * 1024;
+
+	pread_streambuf(int fd, std::uint64_t begin, std::uint64_t end, std::size_t buffer_size = DefaultBufferSize);
+
+   protected:
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in) override;
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in) override;
+
+	std::streamsize showmanyc() override;
+
+	int_type underflow() override;
+
+	// Reads directly into `s` once the get area is drained.
+	std::streamsize xsgetn(char_type* s, std::streamsize count) override;
+
+   private:
+	// Offset in the file of the first character not read.
+	std::uint64_t offset_() const {
+		return this->next_ - static_cast<std::uint64_t>(this->egptr() - this->gptr());
+	}
+
+	int fd_;
+
+	std::uint64_t begin_;
+	std::uint64_t end_;
+	std::uint64_t next_;  // Offset in the file following the get area.
+
+	std::vector<char_type> in_;
+};
+
+// Input stream over the body of an entry of `shared_archive`.
+class pread_istream: public std::istream {
+   public:
+	pread_istream(int fd, std::uint64_t begin, std::uint64_t end);
+	pread_istream(pread_istream&& other);
+
+   private:
+	pread_streambuf buf_;
+};
+
+// Archive read by many threads at once.
+// The index is built once, then each `open` gives a stream with its own cursor
+// that reads by `pread` at absolute offsets, so concurrent readers never share
+// a file offset or a lock. All the member functions are safe to call concurrently.
+class shared_archive {
+   public:
+	// Opens the archive at `p`; the file descriptor is owned.
+	// Throws `std::system_error` if the file cannot be opened or read as in `index`.
+	explicit shared_archive(std::filesystem::path const& p, bool verify_checksum = true);
+
+	// Reads the archive from the current offset of `fd`, which is not owned; it must outlive the archive.
+	explicit shared_archive(int fd, bool verify_checksum = true);
+
+	shared_archive(shared_archive const& other) = delete;
+	shared_archive(shared_archive&& other)      = default;
+
+	shared_archive& operator=(shared_archive const& other) = delete;
+	shared_archive& operator=(shared_archive&& other)      = default;
+
+	int fd() const {
+		return this->fd_;
+	}
+
+	std::span<index::entry const> entries() const {
+		return this->index_.entries();
+	}
+
+	std::size_t size() const {
+		return this->index_.size();
+	}
+
+	std::string_view path(index::entry const& e) const {
+		return this->index_.path(e);
+	}
+
+	index::entry const* find(std::string_view path) const {
+		return this->index_.find(path);
+	}
+
+	pread_istream open(index::entry const& e) const;
+
+	// Throws `std::system_error` if there is no entry with given path.
+	pread_istream open(std::string_view path) const;
+
+   private:
+	shared_archive(detail::unique_fd fd, bool verify_checksum);
+
+	detail::unique_fd owned_;
+
+	int fd_;
+
+	// Buffer `index_` was built from; held so it never points to a destroyed one.
+	// Never read once the index is built, as streams are opened by `pread`.
+	std::unique_ptr<fdbuf> buf_;
+
+	index index_;
+};
+
+}  // namespace ustar
+}  // namespace tar
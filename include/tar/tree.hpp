@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+#include "tar/io.hpp"
+
+namespace tar {
+
+struct write_tree_options {
+	// Number of threads preparing entries; 0 to use all hardware threads.
+	std::size_t threads = 0;
+
+	// Number of entries that can be prepared ahead of the one being written.
+	std::size_t read_ahead = 256;
+
+	// Number of bytes of each body read while preparing its entry.
+	// Files not larger than this are written from memory.
+	std::size_t prefetch_size = 64 * 1024;
+};
+
+// Writes `root` and everything under it to `o`.
+// Entries are named by joining `as`, or `root` if it is empty, with their path relative to `root`.
+// Files are stat-ed, opened and read ahead on several threads while a single writer writes them
+// in the order of a depth-first walk with sorted children, so the output does not depend on scheduling.
+// The walk is fed to the threads as it goes, listing a directory only when it is reached,
+// so writing starts at once and only the listings of the directories being walked are held.
+// Symbolic links are archived as links and not followed.
+// Regular files with holes are written as sparse files as `ostream::next(path)` does.
+// Files with more than one link are written as hard links through `o.links()` as `ostream::next(path)` does.
+// User and group names are resolved through `o.names()`.
+void write_tree(ostream& o, std::filesystem::path const& root, std::filesystem::path const& as = "", write_tree_options const& options = {});
+
+}  // namespace tar
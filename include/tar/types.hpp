@@ -20,6 +20,21 @@ enum class file_type : char {
 	contiguous = '7',
 };
 
+// Region of a sparse file that holds data; the rest of the file are holes.
+struct extent {
+	std::uintmax_t offset;
+	std::uintmax_t size;
+
+	bool operator==(extent const& other) const = default;
+};
+
+// Identifies a file on the file system, to tell links to the same file apart from copies.
+struct file_id {
+	std::uintmax_t device;
+	std::uintmax_t inode;
+	std::uintmax_t links;  // Number of hard links to the file.
+};
+
 struct header {
 	std::filesystem::path  path;
 	std::filesystem::perms permissions;
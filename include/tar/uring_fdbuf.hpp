@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <ios>
+#include <memory>
+#include <streambuf>
+#include <vector>
+
+namespace tar {
+
+struct uring_options {
+	// Number of requests kept in flight.
+	std::size_t depth = 8;
+
+	// Number of bytes of each request.
+	std::size_t block_size = 256 * 1024;
+
+	// Whether to use io_uring if the system supports it; `pread` and `pwrite` are used otherwise.
+	bool use_io_uring = true;
+};
+
+// Stream buffer over a file descriptor which keeps several large reads or writes in flight with io_uring.
+// Reads are issued ahead of the position and writes are queued without waiting for them,
+// so the device sees up to `depth` requests at once rather than one at a time.
+// Falls back to `pread` and `pwrite` issued one at a time where io_uring is not available.
+// The file must support positional I/O such as a regular file or a block device.
+// The file descriptor is not owned; it must outlive the buffer.
+// Its offset is where the buffer starts and is updated on `sync`.
+class uring_fdbuf: public std::streambuf {
+   public:
+	// Implemented by io_uring or by `pread` and `pwrite`.
+	class ring;
+
+	// Throws `std::system_error` if the offset of `fd` cannot be told.
+	uring_fdbuf(int fd, uring_options const& options = {});
+
+	uring_fdbuf(uring_fdbuf const& other) = delete;
+
+	~uring_fdbuf();
+
+	uring_fdbuf& operator=(uring_fdbuf const& other) = delete;
+
+	int fd() const {
+		return this->fd_;
+	}
+
+	// Whether requests go through io_uring.
+	bool uses_io_uring() const;
+
+	// Writes `n` bytes read from `in` at its current offset, keeping reads of `in` and writes of them in flight together.
+	// Returns the number of bytes written, which is less than `n` if `in` reaches its end,
+	// or 0 if `in` does not support positional I/O.
+	std::uintmax_t transfer_from(int in, std::uintmax_t n);
+
+   protected:
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override;
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override;
+
+	int sync() override;
+
+	int_type underflow() override;
+
+	int_type overflow(int_type ch = traits_type::eof()) override;
+
+   private:
+	struct block {
+		std::vector<char> data;
+
+		std::uint64_t offset = 0;  // In the file the request is for.
+		std::size_t   size   = 0;  // Requested.
+		std::int64_t  result = 0;  // Number of bytes transferred, or negated `errno`.
+
+		bool busy    = false;  // Whether the request is in flight.
+		bool writing = false;
+	};
+
+	enum class mode {
+		none,
+		read,
+		write,
+	};
+
+	std::uint64_t position_() const;
+
+	// Whether given block is neither in flight nor holds data to be read.
+	bool free_(std::size_t i) const;
+
+	// Waits for a request to complete.
+	void complete_();
+
+	// Queues the put area to be written, and waits for all requests in flight.
+	// The read-ahead and the areas are dropped, keeping the position.
+	// Returns false if a write failed.
+	bool drain_();
+
+	// Issues reads into free blocks at the end of the read-ahead.
+	void read_ahead_();
+
+	// Moves the get area to `offset` if it is in the area or the read-ahead.
+	bool seek_read_(std::uint64_t offset);
+
+	// Queues the put area to be written.
+	void write_out_();
+
+	int fd_;
+
+	std::vector<block> blocks_;
+
+	// Destroyed before the blocks so no request is left in flight into them.
+	std::unique_ptr<ring> ring_;
+
+	mode          mode_     = mode::none;
+	std::uint64_t base_     = 0;  // Offset in the file of the beginning of the get or the put area.
+	std::size_t   current_  = 0;  // Block of the get or the put area.
+	bool          has_area_ = false;
+	std::size_t   inflight_ = 0;
+	bool          failed_   = false;  // Whether a queued write failed since the last `drain_`.
+
+	std::deque<std::size_t> reads_;      // Blocks read ahead in the order of their offsets.
+	std::uint64_t           read_next_;  // Offset of the next read to issue.
+};
+
+}  // namespace tar
@@ -1,8 +1,18 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <ios>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
 
+#include "tar/detail/marshal.hpp"
 #include "tar/detail/streambuf.hpp"
 #include "tar/io.hpp"
 
@@ -11,6 +21,28 @@ namespace ustar {
 
 std::size_t constexpr BlockSize = 512;
 
+// Returns the number of bytes a body of given size occupies in an archive,
+// i.e. the size rounded up to a multiple of `BlockSize`.
+constexpr std::uintmax_t padded_size(std::uintmax_t size) noexcept {
+	return (size + BlockSize - 1) / BlockSize * BlockSize;
+}
+
+// Tests if a body of given size and its padding, starting at `offset`, stay within positions of a stream,
+// so a corrupted size cannot wrap the position of the next header around.
+constexpr bool fits_stream(std::uintmax_t offset, std::uintmax_t size) noexcept {
+	auto const max = static_cast<std::uintmax_t>(std::numeric_limits<std::streamoff>::max());
+	if(offset > max || max - offset < BlockSize - 1) [[unlikely]] {
+		return false;
+	}
+
+	return size <= max - offset - (BlockSize - 1);
+}
+
+// Type flags of entries carrying PAX extended headers (POSIX.1-2001) rather than files.
+// Records of an extended header apply to the next entry and ones of a global header to all following entries.
+tar::file_type constexpr PaxExtended = tar::file_type('x');
+tar::file_type constexpr PaxGlobal   = tar::file_type('g');
+
 struct header {
 	static header from(tar::header const& header);
 
@@ -35,10 +67,118 @@ struct header {
 	std::array<char, BlockSize - 500> pad = {0};
 
 	operator tar::header();
+
+	// Computes the checksum of the header, taking `chksum` field as spaces.
+	std::uint32_t checksum() const;
+
+	// Tests if `chksum` field matches the content.
+	// Sums of bytes as signed, computed by some historic implementations, are also accepted.
+	bool verify() const;
 };
 
 static_assert(BlockSize == sizeof(header));
 
+// Non-owning view of a header whose fields are decoded only when asked for, without allocating.
+// Strings end at their first NUL or at the end of their field.
+class header_view {
+   public:
+	constexpr header_view(header const& h) noexcept
+	    : h_(&h) { }
+
+	explicit header_view(std::span<char const, BlockSize> block) noexcept
+	    : h_(reinterpret_cast<header const*>(block.data())) { }
+
+	constexpr header const& raw() const noexcept {
+		return *this->h_;
+	}
+
+	constexpr std::string_view name() const noexcept {
+		return view_of(this->h_->name);
+	}
+
+	constexpr std::string_view prefix() const noexcept {
+		return view_of(this->h_->prefix);
+	}
+
+	constexpr std::string_view linkname() const noexcept {
+		return view_of(this->h_->linkname);
+	}
+
+	constexpr std::string_view uname() const noexcept {
+		return view_of(this->h_->uname);
+	}
+
+	constexpr std::string_view gname() const noexcept {
+		return view_of(this->h_->gname);
+	}
+
+	// Whether the path, which is `prefix() + '/' + name()` or `name()` if there is no prefix, equals `p`.
+	constexpr bool path_equals(std::string_view p) const noexcept {
+		auto const pre = this->prefix();
+		if(pre.empty()) {
+			return this->name() == p;
+		}
+
+		return p.size() == pre.size() + 1 + this->name().size()
+		       && p.starts_with(pre) && p[pre.size()] == '/' && p.ends_with(this->name());
+	}
+
+	constexpr tar::file_type type() const noexcept {
+		return this->h_->typeflag;
+	}
+
+	constexpr std::uintmax_t mode() const noexcept {
+		return number_of(this->h_->mode);
+	}
+
+	constexpr std::uintmax_t uid() const noexcept {
+		return number_of(this->h_->uid);
+	}
+
+	constexpr std::uintmax_t gid() const noexcept {
+		return number_of(this->h_->gid);
+	}
+
+	constexpr std::uintmax_t size() const noexcept {
+		return number_of(this->h_->size);
+	}
+
+	// Seconds since the epoch; negative in base-256.
+	constexpr std::intmax_t mtime() const noexcept {
+		return static_cast<std::intmax_t>(number_of(this->h_->mtime));
+	}
+
+	constexpr std::uintmax_t devmajor() const noexcept {
+		return number_of(this->h_->devmajor);
+	}
+
+	constexpr std::uintmax_t devminor() const noexcept {
+		return number_of(this->h_->devminor);
+	}
+
+   private:
+	template<std::size_t N>
+	static constexpr std::string_view view_of(std::array<char, N> const& v) noexcept {
+		return std::string_view(v.data(), static_cast<std::size_t>(std::find(v.begin(), v.end(), '\0') - v.begin()));
+	}
+
+	template<std::size_t N>
+	static constexpr std::uintmax_t number_of(std::array<char, N> const& v) noexcept {
+		std::uintmax_t n;
+		detail::unmarshal(v, n);
+		return n;
+	}
+
+	header const* h_;
+};
+
+// Reads an archive from a stream.
+// Numeric fields (size, uid, gid, mtime) given by PAX extended headers override the ones of the next header,
+// which is handed out in place of the extended header with the values in base-256 where they do not fit in octal.
+// A path given by the extended header, which may not fit in the header, is told by `pax_path`
+// and applied to `tar::header`, as are sparse files of PAX format 1.0 of GNU tar, as `index` does.
+// If the stream is not seekable (e.g. a pipe or a socket), the archive is consumed strictly forward
+// and unread bodies are skipped by reading past them.
 class istream: public tar::istream {
    public:
 	using tar::istream::istream;
@@ -53,35 +193,138 @@ class istream: public tar::istream {
 		this->next(h_);
 
 		h = h_;
+		if(!this->path_.empty()) {
+			h.path = this->path_;
+		}
 		return *this;
 	}
 
 	istream& next(header& h);
 
+	bool seekable() const {
+		return this->seekable_;
+	}
+
+	// Position of the header of the entry last given by `next`, or of the extended header preceding it.
+	// Counted from where the stream was constructed if it is not seekable.
+	pos_type header_offset() const {
+		return this->header_cur_;
+	}
+
+	// Path of the entry last given by `next` if its PAX extended header gave one, otherwise empty.
+	std::string_view pax_path() const {
+		return this->path_;
+	}
+
+	// Whether the body of the entry last given by `next` is a sparse map followed by the data,
+	// which are handed out as they are.
+	bool sparse() const {
+		return this->sparse_;
+	}
+
+	// Size of the file of the entry last given by `next`; differs from the size of its body if `sparse`.
+	std::uintmax_t real_size() const {
+		return this->real_size_;
+	}
+
+	// Whether `next` verifies the checksum of each header; enabled by default.
+	// A header that does not match sets `badbit`.
+	bool verify_checksum() const {
+		return this->verify_;
+	}
+
+	void verify_checksum(bool enabled) {
+		this->verify_ = enabled;
+	}
+
    private:
+	void reach_(pos_type begin, pos_type end);
+
+	pos_type header_cur_ = 0;
 	pos_type header_next_;
+	bool     seekable_;
+	bool     verify_ = true;
 
-	detail::scoped_streambuf buf_;
+	// Of the entry last given by `next`.
+	std::string    path_;
+	bool           sparse_    = false;
+	std::uintmax_t real_size_ = 0;
+
+	detail::bounded_streambuf buf_;
+};
+
+// Tag to open an existing archive for appending.
+struct append_t {
+	explicit append_t() = default;
 };
 
+inline constexpr append_t append{};
+
+// Writes an archive to a stream.
+// Entries started by `next(h)` have their size and checksum patched by seeking back once the body is written,
+// while entries started by `next(h, size)` are written strictly forward so the stream need not be seekable.
 class ostream: public tar::ostream {
    public:
-	using tar::ostream::ostream;
 	using tar::ostream::next;
 
+	ostream(std::streambuf* buf);
+
+	// Appends to the archive in `buf`, which must be seekable, from its current position.
+	// Entries are written over the end-of-archive marker found by scanning the headers,
+	// so only the headers and the new entries are read and written.
+	// Throws `std::system_error` if the archive is malformed or truncated.
+	ostream(std::streambuf* buf, append_t);
+
 	~ostream();
 
 	ostream& next(tar::header const& h) override {
 		return this->next(header::from(h));
 	}
 
+	ostream& next(tar::header const& h, std::uintmax_t size) override {
+		return this->next(header::from(h), size);
+	}
+
 	ostream& next(header const& h);
 
-   private:
+	// Throws `std::system_error` on the next call of `next` if the body written is not `size` long.
+	ostream& next(header const& h, std::uintmax_t size);
+
+	// Written in PAX format 1.0 of GNU tar: a PAX extended header with the name and the size of the file,
+	// followed by an entry whose body is the sparse map and then the data.
+	bool next_sparse(tar::header const& h, std::span<extent const> extents) override;
+
+   protected:
+	// Paths fit in 255 characters through the prefix, but the link target only in the name field.
+	bool can_link_to_(std::filesystem::path const& target) const override {
+		return target.native().size() < std::tuple_size_v<decltype(header::linkname)>;
+	}
+
+	// Supported if the underlying buffer is `tar::fdbuf` or `tar::uring_fdbuf`.
+	std::uintmax_t transfer_(int fd, std::uintmax_t n) override;
+
+	// Ends the current entry by patching its header or checking its size, and padding its body.
+	// Does nothing if there is no entry to end.
 	void seal_();
 
+	// Called with the path of each entry once the previous one is ended and before any header of it is written,
+	// including the extended headers of a sparse file. The flag tells whether the entry was started with its size,
+	// as by `next(h, size)`, or its header is to be patched by seeking back.
+	virtual void begin_entry_(std::string_view, bool) { }
+
+   private:
+	void begin_(header const& h, bool size_known);
+
+	// Writes the header of an entry of `size` characters, ending the current one first.
+	void put_(header const& h, std::uintmax_t size);
+
 	header   header_cur_;
-	pos_type header_pos_ = -1;
+	pos_type header_pos_ = -1;  // Position of the header to be patched.
+
+	std::streamsize body_begin_ = -1;  // Number of characters written before the body of an entry with known size.
+	std::uintmax_t  body_size_  = 0;
+
+	detail::counting_streambuf buf_;
 };
 
 }  // namespace ustar
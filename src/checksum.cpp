@@ -0,0 +1,80 @@
+#include "tar/detail/checksum.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <immintrin.h>
+#endif
+
+namespace tar {
+namespace detail {
+
+std::uint32_t sum_block_scalar(void const* p) noexcept {
+	auto const* const b = static_cast<std::uint8_t const*>(p);
+
+	std::uint32_t sum = 0;
+	for(std::size_t i = 0; i < SumBlockSize; ++i) {
+		sum += b[i];
+	}
+
+	return sum;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("sse2"))) std::uint32_t sum_block_sse2(void const* p) noexcept {
+	auto const* const v = static_cast<__m128i const*>(p);
+
+	// `psadbw` against zero sums each 8 bytes into a 64-bit lane.
+	__m128i const zero = _mm_setzero_si128();
+	__m128i       sum  = _mm_setzero_si128();
+	for(std::size_t i = 0; i < SumBlockSize / sizeof(__m128i); ++i) {
+		sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128(v + i), zero));
+	}
+
+	return static_cast<std::uint32_t>(_mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+}
+
+__attribute__((target("avx2"))) std::uint32_t sum_block_avx2(void const* p) noexcept {
+	auto const* const v = static_cast<__m256i const*>(p);
+
+	__m256i const zero = _mm256_setzero_si256();
+	__m256i       sum  = _mm256_setzero_si256();
+	for(std::size_t i = 0; i < SumBlockSize / sizeof(__m256i); ++i) {
+		sum = _mm256_add_epi64(sum, _mm256_sad_epu8(_mm256_loadu_si256(v + i), zero));
+	}
+
+	__m128i const s = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	return static_cast<std::uint32_t>(_mm_cvtsi128_si32(s) + _mm_cvtsi128_si32(_mm_srli_si128(s, 8)));
+}
+
+bool has_avx2() noexcept {
+	static bool const v = __builtin_cpu_supports("avx2");
+	return v;
+}
+
+std::uint32_t sum_block(void const* p) noexcept {
+	static auto* const f = [] {
+		if(has_avx2()) {
+			return &sum_block_avx2;
+		}
+		if(__builtin_cpu_supports("sse2")) {
+			return &sum_block_sse2;
+		}
+		return &sum_block_scalar;
+	}();
+
+	return f(p);
+}
+
+#else
+
+std::uint32_t sum_block(void const* p) noexcept {
+	return sum_block_scalar(p);
+}
+
+#endif
+
+}  // namespace detail
+}  // namespace tar
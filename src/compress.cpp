@@ -0,0 +1,507 @@
+#include "tar/compress.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <initializer_list>
+#include <ios>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <span>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <zlib.h>
+
+#ifdef TAR_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+namespace tar {
+
+namespace {
+
+// zlib counts input in `uInt`.
+std::size_t constexpr MaxBlockSize = 1024 * 1024 * 1024;
+std::size_t constexpr MinBlockSize = 4 * 1024;
+
+[[noreturn]] void throw_codec_error(std::string const& what) {
+	throw std::system_error(std::make_error_code(std::errc::io_error), what);
+}
+
+class encoder {
+   public:
+	virtual ~encoder() = default;
+
+	// Compresses `in` into `out` as a self-contained member or frame.
+	virtual void encode(std::vector<char> const& in, std::vector<char>& out) = 0;
+};
+
+class gzip_encoder: public encoder {
+   public:
+	gzip_encoder(int level) {
+		// 16 added to the window bits for a gzip header and trailer rather than zlib ones.
+		if(::deflateInit2(&this->s_, level < 0 ? Z_DEFAULT_COMPRESSION : level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+			throw std::system_error(std::make_error_code(std::errc::invalid_argument), "failed to initialize deflate");
+		}
+	}
+
+	~gzip_encoder() {
+		::deflateEnd(&this->s_);
+	}
+
+	void encode(std::vector<char> const& in, std::vector<char>& out) override {
+		if(::deflateReset(&this->s_) != Z_OK) [[unlikely]] {
+			throw_codec_error("failed to reset deflate");
+		}
+
+		out.resize(::deflateBound(&this->s_, static_cast<uLong>(in.size())));
+
+		this->s_.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+		this->s_.avail_in  = static_cast<uInt>(in.size());
+		this->s_.next_out  = reinterpret_cast<Bytef*>(out.data());
+		this->s_.avail_out = static_cast<uInt>(out.size());
+		if(::deflate(&this->s_, Z_FINISH) != Z_STREAM_END) [[unlikely]] {
+			throw_codec_error("failed to deflate");
+		}
+
+		out.resize(this->s_.total_out);
+	}
+
+   private:
+	::z_stream s_ = {};
+};
+
+#ifdef TAR_HAS_ZSTD
+class zstd_encoder: public encoder {
+   public:
+	zstd_encoder(int level)
+	    : ctx_(::ZSTD_createCCtx())
+	    , level_(level < 0 ? ZSTD_CLEVEL_DEFAULT : level) {
+		if(this->ctx_ == nullptr) {
+			throw std::bad_alloc();
+		}
+	}
+
+	~zstd_encoder() {
+		::ZSTD_freeCCtx(this->ctx_);
+	}
+
+	void encode(std::vector<char> const& in, std::vector<char>& out) override {
+		out.resize(::ZSTD_compressBound(in.size()));
+
+		auto const n = ::ZSTD_compressCCtx(this->ctx_, out.data(), out.size(), in.data(), in.size(), this->level_);
+		if(::ZSTD_isError(n)) [[unlikely]] {
+			throw_codec_error(::ZSTD_getErrorName(n));
+		}
+
+		out.resize(n);
+	}
+
+   private:
+	::ZSTD_CCtx* ctx_;
+
+	int level_;
+};
+#endif
+
+std::unique_ptr<encoder> make_encoder(compress_options const& options) {
+	switch(options.codec) {
+	case codec::gzip:
+		return std::make_unique<gzip_encoder>(options.level);
+#ifdef TAR_HAS_ZSTD
+	case codec::zstd:
+		return std::make_unique<zstd_encoder>(options.level);
+#endif
+	default:
+		throw std::system_error(std::make_error_code(std::errc::not_supported), "codec is not supported");
+	}
+}
+
+}  // namespace
+
+bool supports(codec c) {
+	switch(c) {
+	case codec::gzip:
+		return true;
+	case codec::zstd:
+#ifdef TAR_HAS_ZSTD
+		return true;
+#else
+		return false;
+#endif
+	default:
+		return false;
+	}
+}
+
+compress_streambuf::compress_streambuf(std::streambuf* dst, compress_options const& options)
+    : dst_(dst)
+    , options_(options) {
+	// Fails early with invalid options rather than on the first block.
+	make_encoder(this->options_);
+
+	this->options_.block_size = std::clamp(this->options_.block_size, MinBlockSize, MaxBlockSize);
+
+	auto n = options.threads != 0 ? options.threads : std::thread::hardware_concurrency();
+	n      = std::max<std::size_t>(n, 1);
+
+	this->workers_.reserve(n);
+	for(std::size_t i = 0; i < n; ++i) {
+		this->workers_.emplace_back([this] { this->work_(); });
+	}
+
+	this->cur_ = std::make_unique<block>();
+	this->cur_->in.resize(this->options_.block_size);
+	this->setp(this->cur_->in.data(), this->cur_->in.data() + this->cur_->in.size());
+}
+
+compress_streambuf::~compress_streambuf() {
+	try {
+		this->finish();
+	} catch(...) {
+	}
+
+	{
+		std::scoped_lock lock(this->mutex_);
+		this->stop_ = true;
+	}
+	this->cv_.notify_all();
+	this->workers_.clear();
+}
+
+void compress_streambuf::finish() {
+	if(this->finished_) {
+		return;
+	}
+
+	// An empty stream still needs a member (frame) to be valid.
+	this->submit_(this->written_ == 0);
+	this->drain_(0);
+
+	this->finished_ = true;
+	this->setp(nullptr, nullptr);
+	if(this->dst_->pubsync() < 0) [[unlikely]] {
+		throw std::system_error(std::make_error_code(std::errc::io_error), "failed to flush compressed stream");
+	}
+}
+
+compress_streambuf::pos_type compress_streambuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) {
+	if(off != 0 || dir != std::ios_base::cur || !(which & std::ios_base::out)) {
+		return pos_type(off_type(-1));
+	}
+
+	return pos_type(static_cast<off_type>(this->written_ + (this->pptr() - this->pbase())));
+}
+
+int compress_streambuf::sync() {
+	if(this->finished_) {
+		return 0;
+	}
+
+	try {
+		this->submit_();
+		this->drain_(0);
+	} catch(...) {
+		return -1;
+	}
+
+	return this->dst_->pubsync();
+}
+
+compress_streambuf::int_type compress_streambuf::overflow(int_type ch) {
+	if(this->finished_) [[unlikely]] {
+		return traits_type::eof();
+	}
+
+	this->submit_();
+	if(!traits_type::eq_int_type(ch, traits_type::eof())) {
+		*this->pptr() = traits_type::to_char_type(ch);
+		this->pbump(1);
+	}
+
+	return traits_type::not_eof(ch);
+}
+
+void compress_streambuf::cut() {
+	if(this->finished_) [[unlikely]] {
+		return;
+	}
+
+	this->submit_();
+}
+
+void compress_streambuf::work_() {
+	std::unique_ptr<encoder> enc;
+	std::exception_ptr       error;
+	try {
+		enc = make_encoder(this->options_);
+	} catch(...) {
+		error = std::current_exception();
+	}
+
+	while(true) {
+		block* b = nullptr;
+		{
+			std::unique_lock lock(this->mutex_);
+			this->cv_.wait(lock, [&] { return this->stop_ || !this->queue_.empty(); });
+			if(this->queue_.empty()) {
+				return;
+			}
+
+			b = this->queue_.front();
+			this->queue_.pop_front();
+		}
+
+		try {
+			if(error) {
+				std::rethrow_exception(error);
+			}
+			enc->encode(b->in, b->out);
+		} catch(...) {
+			b->error = std::current_exception();
+		}
+
+		{
+			std::scoped_lock lock(this->mutex_);
+			b->done = true;
+		}
+		this->cv_.notify_all();
+	}
+}
+
+void compress_streambuf::submit_(bool force) {
+	auto const n = static_cast<std::size_t>(this->pptr() - this->pbase());
+	if(n == 0 && !force) {
+		return;
+	}
+
+	this->cur_->in.resize(n);
+	this->cur_->offset = this->written_;
+	this->cur_->error  = nullptr;
+	this->cur_->done  = false;
+	this->written_ += n;
+
+	auto* const b = this->cur_.get();
+	this->pending_.push_back(std::move(this->cur_));
+	{
+		std::scoped_lock lock(this->mutex_);
+		this->queue_.push_back(b);
+	}
+	this->cv_.notify_all();
+
+	if(this->free_.empty()) {
+		this->cur_ = std::make_unique<block>();
+	} else {
+		this->cur_ = std::move(this->free_.back());
+		this->free_.pop_back();
+	}
+	this->cur_->in.resize(this->options_.block_size);
+	this->setp(this->cur_->in.data(), this->cur_->in.data() + this->cur_->in.size());
+
+	// Bounds the memory held by blocks in flight.
+	this->drain_(this->workers_.size() * 2);
+}
+
+void compress_streambuf::drain_(std::size_t n) {
+	while(this->pending_.size() > n) {
+		{
+			auto const& b = *this->pending_.front();
+
+			std::unique_lock lock(this->mutex_);
+			this->cv_.wait(lock, [&] { return b.done; });
+		}
+
+		auto b = std::move(this->pending_.front());
+		this->pending_.pop_front();
+		if(b->error) [[unlikely]] {
+			std::rethrow_exception(b->error);
+		}
+
+		auto const size = static_cast<std::streamsize>(b->out.size());
+		if(this->dst_->sputn(b->out.data(), size) != size) [[unlikely]] {
+			throw std::system_error(std::make_error_code(std::errc::io_error), "failed to write compressed block");
+		}
+
+		this->frames_.push_back({.offset = this->compressed_size_, .uncompressed_offset = b->offset});
+		this->compressed_size_ += b->out.size();
+		this->free_.push_back(std::move(b));
+	}
+}
+
+class decompress_streambuf::decoder {
+   public:
+	virtual ~decoder() = default;
+
+	// Decodes `in` into `out` as much as possible.
+	// Returns the number of bytes consumed from `in` and produced into `out`.
+	virtual std::pair<std::size_t, std::size_t> decode(std::span<char const> in, std::span<char> out) = 0;
+
+	// Whether the input decoded so far ends at the end of a member or a frame.
+	virtual bool at_boundary() const = 0;
+};
+
+namespace {
+
+class gzip_decoder: public decompress_streambuf::decoder {
+   public:
+	gzip_decoder() {
+		// Only gzip is accepted, by adding 16 to the window bits.
+		if(::inflateInit2(&this->s_, 15 + 16) != Z_OK) {
+			throw std::bad_alloc();
+		}
+	}
+
+	~gzip_decoder() {
+		::inflateEnd(&this->s_);
+	}
+
+	std::pair<std::size_t, std::size_t> decode(std::span<char const> in, std::span<char> out) override {
+		this->s_.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+		this->s_.avail_in  = static_cast<uInt>(in.size());
+		this->s_.next_out  = reinterpret_cast<Bytef*>(out.data());
+		this->s_.avail_out = static_cast<uInt>(out.size());
+
+		auto const ret = ::inflate(&this->s_, Z_NO_FLUSH);
+		if(ret == Z_STREAM_END) {
+			// Next member follows.
+			::inflateReset(&this->s_);
+			this->in_member_ = false;
+		} else if(ret != Z_OK && ret != Z_BUF_ERROR) [[unlikely]] {
+			throw_codec_error("failed to inflate");
+		} else if(this->s_.avail_in < in.size()) {
+			this->in_member_ = true;
+		}
+
+		return {in.size() - this->s_.avail_in, out.size() - this->s_.avail_out};
+	}
+
+	bool at_boundary() const override {
+		return !this->in_member_;
+	}
+
+   private:
+	::z_stream s_ = {};
+
+	bool in_member_ = false;
+};
+
+#ifdef TAR_HAS_ZSTD
+class zstd_decoder: public decompress_streambuf::decoder {
+   public:
+	zstd_decoder()
+	    : ctx_(::ZSTD_createDCtx()) {
+		if(this->ctx_ == nullptr) {
+			throw std::bad_alloc();
+		}
+	}
+
+	~zstd_decoder() {
+		::ZSTD_freeDCtx(this->ctx_);
+	}
+
+	std::pair<std::size_t, std::size_t> decode(std::span<char const> in, std::span<char> out) override {
+		::ZSTD_inBuffer  i{.src = in.data(), .size = in.size(), .pos = 0};
+		::ZSTD_outBuffer o{.dst = out.data(), .size = out.size(), .pos = 0};
+
+		auto const ret = ::ZSTD_decompressStream(this->ctx_, &o, &i);
+		if(::ZSTD_isError(ret)) [[unlikely]] {
+			throw_codec_error(::ZSTD_getErrorName(ret));
+		}
+		if(i.pos > 0 || o.pos > 0) {
+			// 0 once a frame is decoded and flushed.
+			this->in_frame_ = ret != 0;
+		}
+
+		return {i.pos, o.pos};
+	}
+
+	bool at_boundary() const override {
+		return !this->in_frame_;
+	}
+
+   private:
+	::ZSTD_DCtx* ctx_;
+
+	bool in_frame_ = false;
+};
+#endif
+
+std::unique_ptr<decompress_streambuf::decoder> make_decoder(codec c) {
+	switch(c) {
+	case codec::gzip:
+		return std::make_unique<gzip_decoder>();
+#ifdef TAR_HAS_ZSTD
+	case codec::zstd:
+		return std::make_unique<zstd_decoder>();
+#endif
+	default:
+		throw std::system_error(std::make_error_code(std::errc::not_supported), "codec is not supported");
+	}
+}
+
+}  // namespace
+
+decompress_streambuf::decompress_streambuf(std::streambuf* src, codec c, std::size_t buffer_size)
+    : src_(src)
+    , decoder_(make_decoder(c))
+    , in_(buffer_size)
+    , out_(buffer_size) { }
+
+decompress_streambuf::~decompress_streambuf() { }
+
+decompress_streambuf::int_type decompress_streambuf::underflow() {
+	while(true) {
+		bool end = false;  // Of the source.
+		if(this->in_begin_ == this->in_end_) {
+			auto const n = this->src_->sgetn(this->in_.data(), static_cast<std::streamsize>(this->in_.size()));
+
+			this->in_begin_ = 0;
+			this->in_end_   = n > 0 ? static_cast<std::size_t>(n) : 0;
+			end             = n <= 0;
+		}
+
+		// Decoded even at the end of the source, which may leave output the decoder holds back.
+		auto const in           = std::span<char const>(this->in_.data() + this->in_begin_, this->in_end_ - this->in_begin_);
+		auto const [used, made] = this->decoder_->decode(in, this->out_);
+		this->in_begin_ += used;
+		if(made > 0) {
+			this->setg(this->out_.data(), this->out_.data(), this->out_.data() + made);
+			return traits_type::to_int_type(this->out_[0]);
+		}
+		if(end) {
+			if(!this->decoder_->at_boundary()) [[unlikely]] {
+				throw_codec_error("compressed stream is truncated");
+			}
+			return traits_type::eof();
+		}
+		if(used == 0) [[unlikely]] {
+			throw_codec_error("compressed stream is corrupted");
+		}
+	}
+}
+
+std::optional<codec> detect_codec(std::span<char const> head) {
+	auto const starts_with = [&](std::initializer_list<unsigned char> magic) {
+		return head.size() >= magic.size() && std::equal(magic.begin(), magic.end(), head.begin(), [](unsigned char m, char c) {
+			       return m == static_cast<unsigned char>(c);
+		       });
+	};
+
+	if(starts_with({0x1F, 0x8B})) {
+		return codec::gzip;
+	}
+	if(starts_with({0x28, 0xB5, 0x2F, 0xFD})) {
+		return codec::zstd;
+	}
+
+	return std::nullopt;
+}
+
+}  // namespace tar
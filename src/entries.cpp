@@ -0,0 +1,61 @@
+#include "tar/entries.hpp"
+
+#include <filesystem>
+
+namespace tar {
+namespace ustar {
+
+std::filesystem::path entry::path() const {
+	if(auto const p = this->i_->pax_path(); !p.empty()) {
+		return std::filesystem::path(p);
+	}
+
+	auto const v      = this->view();
+	auto const name   = v.name();
+	auto const prefix = v.prefix();
+	if(prefix.empty()) {
+		return std::filesystem::path(name);
+	}
+
+	return std::filesystem::path(prefix) / name;
+}
+
+tar::header entry::header() const {
+	auto        h = this->h_;
+	tar::header v = static_cast<tar::header>(h);
+	if(auto const p = this->i_->pax_path(); !p.empty()) {
+		v.path = p;
+	}
+
+	return v;
+}
+
+entry_range::entry_range(istream& i) {
+	this->entry_.i_ = &i;
+}
+
+entry_range::iterator entry_range::begin() {
+	if(!this->started_) {
+		this->started_ = true;
+		this->advance_();
+	}
+
+	return iterator(this);
+}
+
+void entry_range::advance_() {
+	if(this->done_) {
+		return;
+	}
+
+	auto& i = *this->entry_.i_;
+	if(!i.next(this->entry_.h_)) {
+		this->done_ = true;
+		return;
+	}
+
+	this->entry_.offset_ = i.header_offset();
+}
+
+}  // namespace ustar
+}  // namespace tar
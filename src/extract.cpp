@@ -0,0 +1,478 @@
+#include "tar/extract.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "tar/detail/fd.hpp"
+#include "tar/detail/marshal.hpp"
+#include "tar/detail/sparse.hpp"
+#include "tar/index.hpp"
+#include "tar/patterns.hpp"
+#include "tar/ustar.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace tar {
+namespace ustar {
+
+namespace {
+
+std::size_t constexpr BufferSize = 1024 * 1024;
+
+using detail::throw_errno;
+using detail::unique_fd;
+
+// Reads exactly `n` bytes from the archive.
+void read_archive(int fd, char* buf, std::size_t n, std::uint64_t offset) {
+	if(detail::pread_full(fd, buf, n, offset) != n) [[unlikely]] {
+		throw std::system_error(std::make_error_code(std::errc::io_error), "archive is truncated");
+	}
+}
+
+header read_header(int fd, std::uint64_t offset) {
+	header h;
+	read_archive(fd, reinterpret_cast<char*>(&h), sizeof(h), offset);
+	return h;
+}
+
+::mode_t mode_of(header const& h) {
+	std::uintmax_t v;
+	detail::unmarshal(h.mode, v);
+	return static_cast<::mode_t>(v & 07777);
+}
+
+// Access time is set to now.
+std::array<::timespec, 2> times_of(header const& h) {
+	std::uintmax_t v;
+	detail::unmarshal(h.mtime, v);
+	return {
+	    ::timespec{.tv_sec = 0, .tv_nsec = UTIME_NOW},
+	    ::timespec{.tv_sec = static_cast<::time_t>(v), .tv_nsec = 0},
+	};
+}
+
+// Path of an entry relative to the destination, split into its parent directory and its name.
+// The name is empty for the destination itself.
+struct target_path {
+	std::filesystem::path parent;
+	std::string           name;
+};
+
+target_path resolve(std::string_view p) {
+	auto rel = std::filesystem::path(p).relative_path().lexically_normal();
+	for(auto const& c: rel) {
+		if(c == "..") {
+			throw std::system_error(std::make_error_code(std::errc::permission_denied), std::string(p));
+		}
+	}
+	if(rel.has_relative_path() && !rel.has_filename()) {
+		// Ends with '/'.
+		rel = rel.parent_path();
+	}
+	if(rel.empty() || rel == ".") {
+		return {};
+	}
+
+	return {rel.parent_path(), rel.filename().string()};
+}
+
+// Opens the directory at `rel` beneath `root`, creating missing ones if `create`.
+// Symbolic links are never followed, so an archive cannot reach outside of `root` through
+// the links it extracts or ones already there.
+unique_fd open_dir(int root, std::filesystem::path const& rel, bool create) {
+	auto constexpr Flags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+
+	unique_fd dir(::openat(root, ".", Flags));
+	for(auto const& c: rel) {
+		if(c.empty() || c == ".") {
+			continue;
+		}
+
+		auto fd = ::openat(dir.get(), c.c_str(), Flags);
+		if(fd < 0 && errno == ENOENT && create) {
+			if(::mkdirat(dir.get(), c.c_str(), 0777) < 0 && errno != EEXIST) {
+				throw_errno();
+			}
+			fd = ::openat(dir.get(), c.c_str(), Flags);
+		}
+		if(fd < 0) {
+			throw std::system_error(errno, std::generic_category(), rel.string());
+		}
+		dir = unique_fd(fd);
+	}
+
+	return dir;
+}
+
+unique_fd open_dir(int root, target_path const& t, bool create) {
+	return open_dir(root, t.parent / t.name, create);
+}
+
+unique_fd open_parent(int root, target_path const& t) {
+	if(t.name.empty()) [[unlikely]] {
+		throw std::system_error(std::make_error_code(std::errc::is_a_directory), "destination itself");
+	}
+
+	return open_dir(root, t.parent, false);
+}
+
+// Removes a file or an empty directory, if any, as `std::filesystem::remove` does.
+void remove_at(int dir, std::string const& name) {
+	if(::unlinkat(dir, name.c_str(), 0) == 0 || errno == ENOENT) {
+		return;
+	}
+	if(errno == EISDIR && ::unlinkat(dir, name.c_str(), AT_REMOVEDIR) == 0) {
+		return;
+	}
+
+	throw_errno();
+}
+
+// Part of a body to be written by a worker.
+struct task {
+	std::size_t   entry;
+	std::uint64_t offset;
+	std::uint64_t size;
+
+	bool whole;  // Whether the task creates the file and writes the whole body.
+};
+
+// Copies `n` bytes at `from` in the archive to `to` in `out`.
+void copy_body(int archive, std::uint64_t from, int out, std::uint64_t to, std::uint64_t n, std::vector<char>& buf) {
+	for(std::uint64_t done = 0; done < n;) {
+		auto const l = static_cast<std::size_t>(std::min<std::uint64_t>(buf.size(), n - done));
+		read_archive(archive, buf.data(), l, from + done);
+		detail::pwrite_full(out, buf.data(), l, to + done);
+		done += l;
+	}
+}
+
+// Writes data of a sparse file at their offsets, leaving the rest as holes.
+void write_sparse_body(int archive, index::entry const& e, int out, std::vector<char>& buf) {
+	auto const invalid = [] {
+		return std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), "malformed sparse map");
+	};
+
+	std::vector<extent> extents;
+	std::string         map;
+	std::size_t         map_size = 0;
+	while(map_size == 0) {
+		if(map.size() >= e.size) [[unlikely]] {
+			throw invalid();
+		}
+
+		auto const l = map.size();
+		map.resize(l + std::min<std::uint64_t>(BlockSize, e.size - l));
+		read_archive(archive, map.data() + l, map.size() - l, e.body_offset + l);
+		map_size = detail::parse_sparse_map(map, extents);
+	}
+	if(map_size + detail::data_size(extents) > e.size) [[unlikely]] {
+		throw invalid();
+	}
+	if(!extents.empty() && extents.back().offset + extents.back().size > e.real_size) [[unlikely]] {
+		throw invalid();
+	}
+
+	if(::ftruncate(out, static_cast<::off_t>(e.real_size)) < 0) {
+		throw_errno();
+	}
+
+	auto from = e.body_offset + map_size;
+	for(auto const& x: extents) {
+		copy_body(archive, from, out, x.offset, x.size, buf);
+		from += x.size;
+	}
+}
+
+void write_body(int archive, index::entry const& e, task const& t, int root, target_path const& target, std::vector<char>& buf) {
+	auto const dir  = open_parent(root, target);
+	auto const name = target.name.c_str();
+
+	int fd = -1;
+	if(t.whole) {
+		auto const flags = O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC;
+
+		fd = ::openat(dir.get(), name, flags, 0600);
+		if(fd < 0 && errno == ELOOP) {
+			// Replace the symbolic link rather than write through it.
+			::unlinkat(dir.get(), name, 0);
+			fd = ::openat(dir.get(), name, flags, 0600);
+		}
+	} else {
+		fd = ::openat(dir.get(), name, O_WRONLY | O_NOFOLLOW | O_CLOEXEC);
+	}
+
+	unique_fd const out(fd);
+	if(e.sparse) {
+		write_sparse_body(archive, e, out.get(), buf);
+	} else {
+		copy_body(archive, e.body_offset + t.offset, out.get(), t.offset, t.size, buf);
+	}
+
+	if(!t.whole) {
+		return;
+	}
+
+	auto const h     = read_header(archive, e.header_offset);
+	auto const times = times_of(h);
+	if(::fchmod(out.get(), mode_of(h)) < 0) {
+		throw_errno();
+	}
+	if(::futimens(out.get(), times.data()) < 0) {
+		throw_errno();
+	}
+}
+
+}  // namespace
+
+void extract(std::filesystem::path const& src, std::filesystem::path const& dst, extract_options const& options) {
+	std::filebuf buf;
+	if(buf.open(src, std::ios_base::in | std::ios_base::binary) == nullptr) {
+		throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), src.string());
+	}
+
+	index const     idx(&buf);
+	unique_fd const archive(::open(src.c_str(), O_RDONLY | O_CLOEXEC));
+
+	std::filesystem::create_directories(dst);
+	unique_fd const root(::open(dst.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+
+	std::unordered_set<std::string> parents;
+
+	auto const ensure_parent = [&](target_path const& t) {
+		if(parents.insert(t.parent.string()).second) {
+			open_dir(root.get(), t.parent, true);
+		}
+	};
+
+	std::vector<std::size_t> dirs;
+	std::vector<std::size_t> links;
+	std::vector<std::size_t> specials;
+	std::vector<std::size_t> chunked;
+	std::vector<task>        tasks;
+
+	auto const entries = idx.entries();
+	for(std::size_t i = 0; i < entries.size(); ++i) {
+		auto const& e = entries[i];
+		auto const  p = idx.path(e);
+		if(options.patterns != nullptr && !options.patterns->selects(p)) {
+			continue;
+		}
+		if(idx.find(p) != &e) {
+			// Overwritten by a later entry.
+			continue;
+		}
+
+		auto const target = resolve(p);
+		switch(e.type) {
+		case file_type::directory:
+			open_dir(root.get(), target, true);
+			parents.insert((target.parent / target.name).string());
+			dirs.push_back(i);
+			break;
+
+		case file_type::hard:
+		case file_type::symlink:
+			ensure_parent(target);
+			links.push_back(i);
+			break;
+
+		case file_type::character:
+		case file_type::block:
+		case file_type::fifo:
+			ensure_parent(target);
+			specials.push_back(i);
+			break;
+
+		default:
+			// Unknown types are extracted as regular files.
+			ensure_parent(target);
+			if(e.sparse || e.size <= options.chunk_size) {
+				tasks.push_back({.entry = i, .offset = 0, .size = e.size, .whole = true});
+				break;
+			}
+
+			// Created here so chunks can be written in any order.
+			{
+				auto const dir = open_parent(root.get(), target);
+				remove_at(dir.get(), target.name);
+
+				unique_fd const out(::openat(dir.get(), target.name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600));
+				if(::ftruncate(out.get(), static_cast<off_t>(e.size)) < 0) {
+					throw_errno();
+				}
+			}
+			for(std::uint64_t offset = 0; offset < e.size; offset += options.chunk_size) {
+				tasks.push_back({
+				    .entry  = i,
+				    .offset = offset,
+				    .size   = std::min<std::uint64_t>(options.chunk_size, e.size - offset),
+				    .whole  = false,
+				});
+			}
+			chunked.push_back(i);
+			break;
+		}
+	}
+
+	// Bodies.
+	{
+		auto n = options.threads != 0 ? options.threads : std::thread::hardware_concurrency();
+		n      = std::clamp<std::size_t>(n, 1, std::max<std::size_t>(tasks.size(), 1));
+
+		std::atomic<std::size_t> next   = 0;
+		std::atomic<bool>        failed = false;
+		std::exception_ptr       error;
+		std::mutex               error_mutex;
+
+		std::vector<std::jthread> workers;
+		workers.reserve(n);
+		for(std::size_t k = 0; k < n; ++k) {
+			workers.emplace_back([&] {
+				std::vector<char> buf(BufferSize);
+				while(!failed.load(std::memory_order_relaxed)) {
+					auto const i = next.fetch_add(1, std::memory_order_relaxed);
+					if(i >= tasks.size()) {
+						break;
+					}
+
+					auto const& t = tasks[i];
+					auto const& e = entries[t.entry];
+					try {
+						write_body(archive.get(), e, t, root.get(), resolve(idx.path(e)), buf);
+					} catch(...) {
+						std::scoped_lock lock(error_mutex);
+						if(!error) {
+							error = std::current_exception();
+						}
+						failed = true;
+					}
+				}
+			});
+		}
+
+		workers.clear();
+		if(error) {
+			std::rethrow_exception(error);
+		}
+	}
+
+	for(auto const i: chunked) {
+		auto const& e      = entries[i];
+		auto const  target = resolve(idx.path(e));
+		auto const  dir    = open_parent(root.get(), target);
+		auto const  h      = read_header(archive.get(), e.header_offset);
+		auto const  times  = times_of(h);
+
+		unique_fd const out(::openat(dir.get(), target.name.c_str(), O_WRONLY | O_NOFOLLOW | O_CLOEXEC));
+		if(::fchmod(out.get(), mode_of(h)) < 0) {
+			throw_errno();
+		}
+		if(::futimens(out.get(), times.data()) < 0) {
+			throw_errno();
+		}
+	}
+
+	for(auto const i: specials) {
+		auto const& e      = entries[i];
+		auto const  target = resolve(idx.path(e));
+		auto const  dir    = open_parent(root.get(), target);
+		auto const  h      = read_header(archive.get(), e.header_offset);
+
+		std::uintmax_t major;
+		std::uintmax_t minor;
+		detail::unmarshal(h.devmajor, major);
+		detail::unmarshal(h.devminor, minor);
+
+		::mode_t type = S_IFIFO;
+		if(e.type == file_type::character) {
+			type = S_IFCHR;
+		} else if(e.type == file_type::block) {
+			type = S_IFBLK;
+		}
+
+		remove_at(dir.get(), target.name);
+		if(::mknodat(dir.get(), target.name.c_str(), type | mode_of(h), ::makedev(major, minor)) < 0) {
+			throw_errno();
+		}
+
+		auto const times = times_of(h);
+		if(::utimensat(dir.get(), target.name.c_str(), times.data(), AT_SYMLINK_NOFOLLOW) < 0) {
+			throw_errno();
+		}
+	}
+
+	// Links are created after the files they may refer to.
+	for(auto const i: links) {
+		auto const& e      = entries[i];
+		auto const  target = resolve(idx.path(e));
+		auto const  dir    = open_parent(root.get(), target);
+		auto const  h      = read_header(archive.get(), e.header_offset);
+
+		std::string link;
+		detail::unmarshal(h.linkname, link);
+
+		remove_at(dir.get(), target.name);
+		if(e.type == file_type::hard) {
+			// Resolved as the path of an entry, so neither can it escape.
+			auto const source     = resolve(link);
+			auto const source_dir = open_parent(root.get(), source);
+			if(::linkat(source_dir.get(), source.name.c_str(), dir.get(), target.name.c_str(), 0) < 0) {
+				throw_errno();
+			}
+			continue;
+		}
+
+		if(::symlinkat(link.c_str(), dir.get(), target.name.c_str()) < 0) {
+			throw_errno();
+		}
+
+		auto const times = times_of(h);
+		if(::utimensat(dir.get(), target.name.c_str(), times.data(), AT_SYMLINK_NOFOLLOW) < 0) {
+			throw_errno();
+		}
+	}
+
+	// Deeper ones first so permissions of a directory are applied after all of its children,
+	// which may deny further changes in it.
+	std::vector<std::size_t> depths(entries.size());
+	for(auto const i: dirs) {
+		auto const p = idx.path(entries[i]);
+		depths[i]    = std::count(p.begin(), p.end(), '/') - (p.ends_with('/') ? 1 : 0);
+	}
+	std::stable_sort(dirs.begin(), dirs.end(), [&](auto lhs, auto rhs) { return depths[lhs] > depths[rhs]; });
+	for(auto const i: dirs) {
+		auto const& e      = entries[i];
+		auto const  dir    = open_dir(root.get(), resolve(idx.path(e)), false);
+		auto const  h      = read_header(archive.get(), e.header_offset);
+		auto const  times  = times_of(h);
+		if(::fchmod(dir.get(), mode_of(h)) < 0) {
+			throw_errno();
+		}
+		if(::futimens(dir.get(), times.data()) < 0) {
+			throw_errno();
+		}
+	}
+}
+
+}  // namespace ustar
+}  // namespace tar
@@ -0,0 +1,102 @@
+#include "tar/detail/fd.hpp"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <system_error>
+
+#include <unistd.h>
+
+namespace tar {
+namespace detail {
+
+void throw_errno() {
+	throw std::system_error(errno, std::generic_category(), std::strerror(errno));
+}
+
+unique_fd::unique_fd(int fd)
+    : fd_(fd) {
+	if(this->fd_ < 0) {
+		throw_errno();
+	}
+}
+
+unique_fd::~unique_fd() {
+	if(this->fd_ >= 0) {
+		::close(this->fd_);
+	}
+}
+
+std::size_t read_full(int fd, char* buf, std::size_t n) {
+	std::size_t done = 0;
+	while(done < n) {
+		auto const l = ::read(fd, buf + done, n - done);
+		if(l < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			throw_errno();
+		}
+		if(l == 0) {
+			break;
+		}
+
+		done += static_cast<std::size_t>(l);
+	}
+
+	return done;
+}
+
+std::size_t pread_full(int fd, char* buf, std::size_t n, std::uint64_t offset) {
+	std::size_t done = 0;
+	while(done < n) {
+		auto const l = ::pread(fd, buf + done, n - done, static_cast<::off_t>(offset + done));
+		if(l < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			throw_errno();
+		}
+		if(l == 0) {
+			break;
+		}
+
+		done += static_cast<std::size_t>(l);
+	}
+
+	return done;
+}
+
+void write_full(int fd, char const* buf, std::size_t n) {
+	std::size_t done = 0;
+	while(done < n) {
+		auto const l = ::write(fd, buf + done, n - done);
+		if(l < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			throw_errno();
+		}
+
+		done += static_cast<std::size_t>(l);
+	}
+}
+
+void pwrite_full(int fd, char const* buf, std::size_t n, std::uint64_t offset) {
+	std::size_t done = 0;
+	while(done < n) {
+		auto const l = ::pwrite(fd, buf + done, n - done, static_cast<::off_t>(offset + done));
+		if(l < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			throw_errno();
+		}
+
+		done += static_cast<std::size_t>(l);
+	}
+}
+
+}  // namespace detail
+}  // namespace tar
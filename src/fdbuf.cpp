@@ -0,0 +1,207 @@
+#include "tar/fdbuf.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <ios>
+#include <system_error>
+
+#include "tar/detail/fd.hpp"
+
+#include <sys/sendfile.h>
+#include <unistd.h>
+
+namespace tar {
+
+namespace {
+
+// Largest number of bytes moved by a single system call.
+std::size_t constexpr TransferSize = 1 << 30;
+
+}  // namespace
+
+fdbuf::fdbuf(int fd, std::size_t buffer_size)
+    : fd_(fd)
+    , in_(buffer_size)
+    , out_(buffer_size) {
+	this->setg(this->in_.data(), this->in_.data(), this->in_.data());
+	this->setp(this->out_.data(), this->out_.data() + this->out_.size());
+}
+
+// The get area and the put area are never active at the same time;
+// `underflow` disables the put area and `overflow` drops the get area.
+
+fdbuf::~fdbuf() {
+	this->flush_();
+}
+
+std::uintmax_t fdbuf::transfer_from(int in, std::uintmax_t n) {
+	if(this->sync() != 0) [[unlikely]] {
+		return 0;
+	}
+
+	std::uintmax_t done = 0;
+
+	bool copy_range = true;
+	while(done < n) {
+		auto const count = static_cast<std::size_t>(std::min<std::uintmax_t>(n - done, TransferSize));
+
+		::ssize_t l;
+		if(copy_range) {
+			l = ::copy_file_range(in, nullptr, this->fd_, nullptr, count, 0);
+			if(l < 0 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP || errno == EBADF)) {
+				// Not supported between the two; `sendfile` may be.
+				copy_range = false;
+				continue;
+			}
+		} else {
+			l = ::sendfile(this->fd_, in, nullptr, count);
+			if(l < 0 && (errno == EINVAL || errno == ENOSYS)) {
+				break;
+			}
+		}
+
+		if(l < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			detail::throw_errno();
+		}
+		if(l == 0) {
+			break;
+		}
+
+		done += static_cast<std::uintmax_t>(l);
+	}
+
+	return done;
+}
+
+fdbuf::pos_type fdbuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode) {
+	if(dir == std::ios_base::cur && off == 0) {
+		// Tells the position without touching the buffers.
+		auto const pos = ::lseek(this->fd_, 0, SEEK_CUR);
+		if(pos < 0) {
+			return pos_type(off_type(-1));
+		}
+
+		return pos_type(pos - (this->egptr() - this->gptr()) + (this->pptr() - this->pbase()));
+	}
+	if(!this->flush_() || !this->unread_()) [[unlikely]] {
+		return pos_type(off_type(-1));
+	}
+
+	int whence = SEEK_SET;
+	switch(dir) {
+	case std::ios_base::cur:
+		whence = SEEK_CUR;
+		break;
+	case std::ios_base::end:
+		whence = SEEK_END;
+		break;
+	default:
+		break;
+	}
+
+	return pos_type(::lseek(this->fd_, off, whence));
+}
+
+fdbuf::pos_type fdbuf::seekpos(pos_type pos, std::ios_base::openmode which) {
+	return this->seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+int fdbuf::sync() {
+	return (this->flush_() && this->unread_()) ? 0 : -1;
+}
+
+fdbuf::int_type fdbuf::underflow() {
+	if(this->gptr() < this->egptr()) {
+		return traits_type::to_int_type(*this->gptr());
+	}
+	if(!this->flush_()) [[unlikely]] {
+		return traits_type::eof();
+	}
+	this->setp(this->out_.data(), this->out_.data());
+
+	::ssize_t l;
+	do {
+		l = ::read(this->fd_, this->in_.data(), this->in_.size());
+	} while(l < 0 && errno == EINTR);
+	if(l <= 0) {
+		this->setg(this->in_.data(), this->in_.data(), this->in_.data());
+		return traits_type::eof();
+	}
+
+	this->setg(this->in_.data(), this->in_.data(), this->in_.data() + l);
+	return traits_type::to_int_type(*this->gptr());
+}
+
+fdbuf::int_type fdbuf::overflow(int_type ch) {
+	if(!this->unread_() || !this->flush_()) [[unlikely]] {
+		return traits_type::eof();
+	}
+	this->setp(this->out_.data(), this->out_.data() + this->out_.size());
+	if(traits_type::eq_int_type(ch, traits_type::eof())) {
+		return traits_type::not_eof(ch);
+	}
+
+	*this->pptr() = traits_type::to_char_type(ch);
+	this->pbump(1);
+	return ch;
+}
+
+std::streamsize fdbuf::xsputn(char_type const* s, std::streamsize count) {
+	if(count <= this->epptr() - this->pptr()) {
+		traits_type::copy(this->pptr(), s, static_cast<std::size_t>(count));
+		this->pbump(static_cast<int>(count));
+		return count;
+	}
+
+	if(!this->unread_() || !this->flush_()) [[unlikely]] {
+		return 0;
+	}
+	this->setp(this->out_.data(), this->out_.data() + this->out_.size());
+
+	// Large writes go directly to the file.
+	if(static_cast<std::size_t>(count) < this->out_.size()) {
+		traits_type::copy(this->pptr(), s, static_cast<std::size_t>(count));
+		this->pbump(static_cast<int>(count));
+		return count;
+	}
+
+	try {
+		detail::write_full(this->fd_, s, static_cast<std::size_t>(count));
+	} catch(std::system_error const&) {
+		return 0;
+	}
+	return count;
+}
+
+bool fdbuf::flush_() {
+	auto const n = this->pptr() - this->pbase();
+	if(n == 0) {
+		return true;
+	}
+
+	try {
+		detail::write_full(this->fd_, this->pbase(), static_cast<std::size_t>(n));
+	} catch(std::system_error const&) {
+		return false;
+	}
+
+	this->setp(this->pbase(), this->epptr());
+	return true;
+}
+
+bool fdbuf::unread_() {
+	auto const n = this->egptr() - this->gptr();
+	this->setg(this->in_.data(), this->in_.data(), this->in_.data());
+	if(n == 0) {
+		return true;
+	}
+
+	return ::lseek(this->fd_, -static_cast<::off_t>(n), SEEK_CUR) >= 0;
+}
+
+}  // namespace tar
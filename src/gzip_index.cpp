@@ -0,0 +1,453 @@
+#include "tar/gzip_index.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ios>
+#include <memory>
+#include <new>
+#include <span>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <zlib.h>
+
+// Layout of a saved index, all integers in little-endian:
+//
+//   `Magic`
+//   u64 size of the compressed stream
+//   u64 number of checkpoints, followed by each checkpoint:
+//     u64 offset in the compressed stream
+//     u64 offset in the uncompressed stream
+//     u8  number of bits not consumed
+//     u32 size of the window
+//     window
+//   u64 number of entries, followed by each entry:
+//     u64 offset of the header in the uncompressed stream
+//     u32 size of the path
+//     path
+
+namespace tar {
+namespace ustar {
+
+namespace {
+
+std::string_view constexpr Magic = "TARGZIX1";
+
+std::size_t constexpr BufferSize = 64 * 1024;
+
+// Size of the CRC32 and ISIZE that end a gzip member.
+std::size_t constexpr GzipTrailerSize = 4 + 4;
+
+[[noreturn]] void throw_malformed() {
+	throw std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), "malformed gzip index");
+}
+
+void put(std::string& dst, std::uint64_t v, std::size_t n) {
+	for(std::size_t i = 0; i < n; ++i) {
+		dst.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+	}
+}
+
+std::uint64_t get(std::string_view& src, std::size_t n) {
+	if(src.size() < n) [[unlikely]] {
+		throw_malformed();
+	}
+
+	std::uint64_t v = 0;
+	for(std::size_t i = 0; i < n; ++i) {
+		v |= std::uint64_t(static_cast<std::uint8_t>(src[i])) << (8 * i);
+	}
+
+	src.remove_prefix(n);
+	return v;
+}
+
+// Inflates concatenated gzip members, either from the beginning of one or from a checkpoint in the middle of one.
+class inflater: public std::streambuf {
+   public:
+	// Starts at the beginning of a member at the current position of `src`.
+	inflater(std::streambuf* src)
+	    : src_(src) {
+		// Only gzip is accepted, by adding 16 to the window bits.
+		if(::inflateInit2(&this->s_, 15 + 16) != Z_OK) {
+			throw std::bad_alloc();
+		}
+	}
+
+	// Starts from `c` with `src` positioned at `c.in`, where `prev` is the byte before it.
+	inflater(std::streambuf* src, gzip_index::checkpoint const& c, std::span<char const> window, std::uint8_t prev)
+	    : src_(src)
+	    , in_total_(c.in)
+	    , out_total_(c.out)
+	    , raw_(true)
+	    , ended_(false) {
+		// Raw deflate as the header of the member is already consumed.
+		if(::inflateInit2(&this->s_, -15) != Z_OK) {
+			throw std::bad_alloc();
+		}
+		if(c.bits > 0) {
+			::inflatePrime(&this->s_, c.bits, prev >> (8 - c.bits));
+		}
+		if(!window.empty()) {
+			::inflateSetDictionary(&this->s_, reinterpret_cast<Bytef const*>(window.data()), static_cast<uInt>(window.size()));
+		}
+	}
+
+	inflater(inflater const& other) = delete;
+
+	~inflater() {
+		::inflateEnd(&this->s_);
+	}
+
+	inflater& operator=(inflater const& other) = delete;
+
+	// Saves a checkpoint at the first block boundary after each `span` bytes of output.
+	void record(std::vector<gzip_index::checkpoint>& checkpoints, std::vector<char>& windows, std::uint64_t span) {
+		this->checkpoints_ = &checkpoints;
+		this->windows_     = &windows;
+		this->span_        = span;
+	}
+
+	std::uint64_t in_total() const {
+		return this->in_total_;
+	}
+
+   protected:
+	int_type underflow() override {
+		while(true) {
+			if(this->s_.avail_in == 0 && !this->fill_()) {
+				if(!this->ended_) [[unlikely]] {
+					throw std::system_error(std::make_error_code(std::errc::io_error), "archive is truncated");
+				}
+				return traits_type::eof();
+			}
+			if(this->trailer_left_ > 0) {
+				auto const n = std::min<std::size_t>(this->trailer_left_, this->s_.avail_in);
+				this->consume_(n);
+				this->trailer_left_ -= n;
+				continue;
+			}
+
+			this->s_.next_out  = reinterpret_cast<Bytef*>(this->out_.data());
+			this->s_.avail_out = static_cast<uInt>(this->out_.size());
+
+			auto const avail_in = this->s_.avail_in;
+			auto const ret      = ::inflate(&this->s_, Z_BLOCK);
+			if(ret != Z_OK && ret != Z_STREAM_END) [[unlikely]] {
+				throw std::system_error(std::make_error_code(std::errc::io_error), "failed to inflate");
+			}
+
+			auto const used = avail_in - this->s_.avail_in;
+			auto const made = this->out_.size() - this->s_.avail_out;
+			this->in_total_ += used;
+			this->out_total_ += made;
+			this->ended_ = this->ended_ && used == 0;
+
+			if(ret == Z_STREAM_END) {
+				this->ended_ = true;
+				if(this->raw_) {
+					// Trailer of the member is left to skip before the next one.
+					this->raw_          = false;
+					this->trailer_left_ = GzipTrailerSize;
+					::inflateReset2(&this->s_, 15 + 16);
+				} else {
+					::inflateReset(&this->s_);
+				}
+			} else if((this->s_.data_type & 128) && !(this->s_.data_type & 64)) {
+				// At the end of a block (or a header) which is not the last one.
+				this->boundary_();
+			}
+
+			if(made > 0) {
+				this->setg(this->out_.data(), this->out_.data(), this->out_.data() + made);
+				return traits_type::to_int_type(this->out_[0]);
+			}
+		}
+	}
+
+   private:
+	bool fill_() {
+		auto const n = this->src_->sgetn(this->in_.data(), static_cast<std::streamsize>(this->in_.size()));
+		if(n <= 0) {
+			return false;
+		}
+
+		this->s_.next_in  = reinterpret_cast<Bytef*>(this->in_.data());
+		this->s_.avail_in = static_cast<uInt>(n);
+		return true;
+	}
+
+	void consume_(std::size_t n) {
+		this->s_.next_in += n;
+		this->s_.avail_in -= static_cast<uInt>(n);
+		this->in_total_ += n;
+	}
+
+	void boundary_() {
+		if(this->checkpoints_ == nullptr) {
+			return;
+		}
+		if(!this->checkpoints_->empty() && this->out_total_ - this->checkpoints_->back().out < this->span_) {
+			return;
+		}
+
+		std::array<char, gzip_index::WindowSize> window;
+
+		uInt size = 0;
+		::inflateGetDictionary(&this->s_, reinterpret_cast<Bytef*>(window.data()), &size);
+
+		this->checkpoints_->push_back({
+		    .in            = this->in_total_,
+		    .out           = this->out_total_,
+		    .bits          = static_cast<std::uint8_t>(this->s_.data_type & 7),
+		    .window_offset = this->windows_->size(),
+		    .window_size   = size,
+		});
+		this->windows_->insert(this->windows_->end(), window.begin(), window.begin() + size);
+	}
+
+	std::streambuf* src_;
+	::z_stream      s_ = {};
+
+	std::array<char, BufferSize> in_;
+	std::array<char, BufferSize> out_;
+
+	std::uint64_t in_total_  = 0;  // Consumed from the compressed stream.
+	std::uint64_t out_total_ = 0;  // Made in the uncompressed stream.
+
+	bool        raw_          = false;  // Whether in the middle of a member started from a checkpoint.
+	bool        ended_        = true;   // Whether at the end of a member (or before the first one).
+	std::size_t trailer_left_ = 0;
+
+	std::vector<gzip_index::checkpoint>* checkpoints_ = nullptr;
+	std::vector<char>*                   windows_     = nullptr;
+	std::uint64_t                        span_        = 0;
+};
+
+// Constructed before `gzip_istream`'s stream so it can skip to the entry before the stream reads.
+class gzip_istream_base {
+   protected:
+	gzip_istream_base(std::streambuf* src, gzip_index::checkpoint const& c, std::span<char const> window, std::uint8_t prev, std::uint64_t skip)
+	    : inflater_(src, c, window, prev) {
+		std::array<char, 4096> discard;
+		while(skip > 0) {
+			auto const n = std::min<std::uint64_t>(skip, discard.size());
+			if(this->inflater_.sgetn(discard.data(), static_cast<std::streamsize>(n)) != static_cast<std::streamsize>(n)) [[unlikely]] {
+				throw std::system_error(std::make_error_code(std::errc::io_error), "archive is truncated");
+			}
+			skip -= n;
+		}
+	}
+
+	inflater inflater_;
+};
+
+class gzip_istream: private gzip_istream_base, public istream {
+   public:
+	gzip_istream(std::streambuf* src, gzip_index::checkpoint const& c, std::span<char const> window, std::uint8_t prev, std::uint64_t skip)
+	    : gzip_istream_base(src, c, window, prev, skip)
+	    , istream(&this->inflater_) { }
+};
+
+}  // namespace
+
+gzip_index::gzip_index(std::streambuf* src, std::uint64_t span)
+    : src_(src)
+    , base_(src->pubseekoff(0, std::ios_base::cur, std::ios_base::in)) {
+	auto buf = std::make_unique<inflater>(src);
+	buf->record(this->checkpoints_, this->windows_, span);
+
+	// The stream is not seekable so positions of headers are counted in the uncompressed stream.
+	istream i(buf.get());
+
+	header h;
+	while(i.next(h)) {
+		// Path of a PAX extended header, e.g. the real one of a sparse file, over the one in the header.
+		auto path = std::string(i.pax_path());
+		if(path.empty()) {
+			path = static_cast<tar::header>(h).path.string();
+		}
+
+		this->entries_.push_back({
+		    .offset      = static_cast<std::uint64_t>(std::streamoff(i.header_offset())),
+		    .path_offset = static_cast<std::uint32_t>(this->paths_.size()),
+		    .path_size   = static_cast<std::uint32_t>(path.size()),
+		});
+		this->paths_.insert(this->paths_.end(), path.begin(), path.end());
+	}
+	if(i.bad()) [[unlikely]] {
+		throw std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), "malformed archive");
+	}
+
+	// Rest of the stream, e.g. padding after the end of archive, is consumed so its size is known.
+	while(buf->sbumpc() != std::streambuf::traits_type::eof()) { }
+	this->size_ = buf->in_total();
+
+	this->index_paths_();
+}
+
+gzip_index gzip_index::load(std::streambuf* src, std::streambuf* saved) {
+	gzip_index index;
+	index.src_  = src;
+	index.base_ = src->pubseekoff(0, std::ios_base::cur, std::ios_base::in);
+
+	std::string data;
+	{
+		std::array<char, BufferSize> buf;
+		while(true) {
+			auto const n = saved->sgetn(buf.data(), static_cast<std::streamsize>(buf.size()));
+			if(n <= 0) {
+				break;
+			}
+			data.append(buf.data(), static_cast<std::size_t>(n));
+		}
+	}
+
+	std::string_view r = data;
+	if(!r.starts_with(Magic)) {
+		throw_malformed();
+	}
+	r.remove_prefix(Magic.size());
+
+	index.size_ = get(r, 8);
+	if(index.base_ >= 0) {
+		auto const end = src->pubseekoff(0, std::ios_base::end, std::ios_base::in);
+		src->pubseekpos(index.base_, std::ios_base::in);
+		if(end - index.base_ != static_cast<std::streamoff>(index.size_)) {
+			throw std::system_error(std::make_error_code(std::errc::invalid_argument), "archive differs from the indexed one");
+		}
+	}
+
+	auto const checkpoint_count = get(r, 8);
+	if(checkpoint_count > r.size() / 21) [[unlikely]] {
+		throw_malformed();
+	}
+	index.checkpoints_.reserve(checkpoint_count);
+	for(std::uint64_t i = 0; i < checkpoint_count; ++i) {
+		checkpoint c{};
+		c.in          = get(r, 8);
+		c.out         = get(r, 8);
+		c.bits        = static_cast<std::uint8_t>(get(r, 1));
+		c.window_size = static_cast<std::uint32_t>(get(r, 4));
+		if(c.bits > 7 || c.window_size > WindowSize || r.size() < c.window_size) [[unlikely]] {
+			throw_malformed();
+		}
+
+		c.window_offset = index.windows_.size();
+		index.windows_.insert(index.windows_.end(), r.begin(), r.begin() + c.window_size);
+		r.remove_prefix(c.window_size);
+
+		index.checkpoints_.push_back(c);
+	}
+
+	auto const entry_count = get(r, 8);
+	if(entry_count > r.size() / 12) [[unlikely]] {
+		throw_malformed();
+	}
+	index.entries_.reserve(entry_count);
+	for(std::uint64_t i = 0; i < entry_count; ++i) {
+		auto const offset = get(r, 8);
+		auto const size   = get(r, 4);
+		if(r.size() < size) [[unlikely]] {
+			throw_malformed();
+		}
+
+		index.entries_.push_back({
+		    .offset      = offset,
+		    .path_offset = static_cast<std::uint32_t>(index.paths_.size()),
+		    .path_size   = static_cast<std::uint32_t>(size),
+		});
+		index.paths_.insert(index.paths_.end(), r.begin(), r.begin() + size);
+		r.remove_prefix(size);
+	}
+
+	index.index_paths_();
+	return index;
+}
+
+void gzip_index::save(std::streambuf* dst) const {
+	std::string data(Magic);
+	put(data, this->size_, 8);
+
+	put(data, this->checkpoints_.size(), 8);
+	for(auto const& c: this->checkpoints_) {
+		put(data, c.in, 8);
+		put(data, c.out, 8);
+		put(data, c.bits, 1);
+		put(data, c.window_size, 4);
+
+		auto const w = this->window(c);
+		data.append(w.data(), w.size());
+	}
+
+	put(data, this->entries_.size(), 8);
+	for(auto const& e: this->entries_) {
+		put(data, e.offset, 8);
+		put(data, e.path_size, 4);
+		data += this->path(e);
+	}
+
+	if(dst->sputn(data.data(), static_cast<std::streamsize>(data.size())) != static_cast<std::streamsize>(data.size())) [[unlikely]] {
+		throw std::system_error(std::make_error_code(std::errc::io_error), "failed to write gzip index");
+	}
+}
+
+void gzip_index::index_paths_() {
+	// Keys refer to `paths_` so it must not grow after this.
+	this->lookup_.reserve(this->entries_.size());
+	for(std::size_t i = 0; i < this->entries_.size(); ++i) {
+		// Later entries overwrite earlier ones with the same path.
+		this->lookup_.insert_or_assign(this->path(this->entries_[i]), i);
+	}
+}
+
+gzip_index::entry const* gzip_index::find(std::string_view path) const {
+	auto const it = this->lookup_.find(path);
+	if(it == this->lookup_.end()) {
+		return nullptr;
+	}
+
+	return &this->entries_[it->second];
+}
+
+std::unique_ptr<istream> gzip_index::open(entry const& e) const {
+	if(this->base_ < 0) [[unlikely]] {
+		throw std::system_error(std::make_error_code(std::errc::invalid_seek));
+	}
+
+	// Last checkpoint at or before the entry.
+	auto it = std::upper_bound(this->checkpoints_.begin(), this->checkpoints_.end(), e.offset, [](std::uint64_t offset, checkpoint const& c) {
+		return offset < c.out;
+	});
+	if(it == this->checkpoints_.begin()) [[unlikely]] {
+		throw_malformed();
+	}
+	--it;
+
+	std::uint8_t prev = 0;
+	if(it->bits > 0) {
+		this->src_->pubseekpos(this->base_ + static_cast<std::streamoff>(it->in) - 1, std::ios_base::in);
+		prev = static_cast<std::uint8_t>(this->src_->sbumpc());
+	} else {
+		this->src_->pubseekpos(this->base_ + static_cast<std::streamoff>(it->in), std::ios_base::in);
+	}
+
+	return std::make_unique<gzip_istream>(this->src_, *it, this->window(*it), prev, e.offset - it->out);
+}
+
+std::unique_ptr<istream> gzip_index::open(std::string_view path) const {
+	auto const* e = this->find(path);
+	if(e == nullptr) {
+		throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), std::string(path));
+	}
+
+	return this->open(*e);
+}
+
+}  // namespace ustar
+}  // namespace tar
@@ -0,0 +1,152 @@
+#include "tar/index.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <ios>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include "tar/detail/marshal.hpp"
+#include "tar/detail/pax.hpp"
+#include "tar/ustar.hpp"
+
+namespace tar {
+namespace ustar {
+
+body_istream::body_istream(std::streambuf* buf, pos_type begin, pos_type end)
+    : std::istream(nullptr)
+    , buf_(buf) {
+	this->buf_.reset(begin, end);
+	this->init(&this->buf_);
+}
+
+body_istream::body_istream(body_istream&& other)
+    : std::istream(std::move(other))
+    , buf_(std::move(other.buf_)) {
+	this->set_rdbuf(&this->buf_);
+}
+
+index::index(std::streambuf* buf, bool verify_checksum)
+    : buf_(buf) {
+	using pos_type = std::streambuf::pos_type;
+	using off_type = std::streambuf::off_type;
+
+	pos_type header_next = buf->pubseekoff(0, std::ios_base::cur, std::ios_base::in);
+	if(header_next == pos_type(off_type(-1))) [[unlikely]] {
+		throw std::system_error(std::make_error_code(std::errc::invalid_seek));
+	}
+
+	header      h;
+	std::string records;  // Of a PAX extended header, applied to the next header.
+	while(true) {
+		if(buf->pubseekpos(header_next, std::ios_base::in) != header_next) [[unlikely]] {
+			break;
+		}
+		if(buf->sgetn(reinterpret_cast<char*>(&h), sizeof(h)) != sizeof(h)) [[unlikely]] {
+			break;
+		}
+		if(h.name[0] == '\0') [[unlikely]] {
+			// End of archive.
+			break;
+		}
+		if(verify_checksum && !h.verify()) [[unlikely]] {
+			throw std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), "header checksum mismatch");
+		}
+
+		detail::pax_entry pax;  // Path given by PAX records may not fit in the header.
+		if(!records.empty()) {
+			if(!detail::apply_pax(records, h)) [[unlikely]] {
+				throw std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), "malformed PAX extended header");
+			}
+			pax = detail::read_pax_entry(records);
+			records.clear();
+		}
+
+		auto const body_begin = header_next + static_cast<off_type>(sizeof(header));
+
+		std::uintmax_t size;
+		if(!detail::unmarshal_size(h.size, size) || !fits_stream(static_cast<std::uintmax_t>(off_type(body_begin)), size)) [[unlikely]] {
+			throw std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), "invalid size in header");
+		}
+		if(h.typeflag == PaxExtended || h.typeflag == PaxGlobal) [[unlikely]] {
+			if(size > detail::MaxPaxSize) [[unlikely]] {
+				throw std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), "PAX extended header too large");
+			}
+
+			records.resize(size);
+			if(buf->sgetn(records.data(), static_cast<std::streamsize>(size)) != static_cast<std::streamsize>(size)) [[unlikely]] {
+				break;
+			}
+			if(h.typeflag == PaxGlobal) {
+				// Not supported; global records are ignored.
+				records.clear();
+			}
+
+			header_next = body_begin + static_cast<off_type>(padded_size(size));
+			continue;
+		}
+
+		auto const view   = header_view(h);
+		auto const prefix = view.prefix();
+		auto const name   = view.name();
+
+		entry e{
+		    .header_offset = static_cast<std::uint64_t>(off_type(header_next)),
+		    .body_offset   = static_cast<std::uint64_t>(off_type(body_begin)),
+		    .size          = size,
+		    .real_size     = pax.sparse ? pax.real_size : size,
+
+		    .path_offset = static_cast<std::uint32_t>(this->paths_.size()),
+
+		    .type   = h.typeflag,
+		    .sparse = pax.sparse,
+		};
+		if(!pax.path.empty()) {
+			this->paths_.insert(this->paths_.end(), pax.path.begin(), pax.path.end());
+		} else {
+			if(!prefix.empty()) {
+				this->paths_.insert(this->paths_.end(), prefix.begin(), prefix.end());
+				this->paths_.push_back('/');
+			}
+			this->paths_.insert(this->paths_.end(), name.begin(), name.end());
+		}
+		e.path_size = static_cast<std::uint32_t>(this->paths_.size() - e.path_offset);
+		this->entries_.push_back(e);
+
+		header_next = body_begin + static_cast<off_type>(padded_size(size));
+	}
+
+	// Keys refer to `paths_` so it must not grow after this.
+	this->lookup_.reserve(this->entries_.size());
+	for(std::size_t i = 0; i < this->entries_.size(); ++i) {
+		// Later entries overwrite earlier ones with the same path.
+		this->lookup_.insert_or_assign(this->path(this->entries_[i]), i);
+	}
+}
+
+index::entry const* index::find(std::string_view path) const {
+	auto const it = this->lookup_.find(path);
+	if(it == this->lookup_.end()) {
+		return nullptr;
+	}
+
+	return &this->entries_[it->second];
+}
+
+body_istream index::open(entry const& e) const {
+	return body_istream(this->buf_, std::streamoff(e.body_offset), std::streamoff(e.body_offset + e.size));
+}
+
+body_istream index::open(std::string_view path) const {
+	auto const* e = this->find(path);
+	if(e == nullptr) {
+		throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), std::string(path));
+	}
+
+	return this->open(*e);
+}
+
+}  // namespace ustar
+}  // namespace tar
@@ -1,40 +1,45 @@
 #include "tar/io.hpp"
 
+#include <algorithm>
 #include <cerrno>
+#include <chrono>
 #include <cstring>
 #include <filesystem>
-#include <fstream>
 #include <ios>
 #include <iostream>
+#include <span>
+#include <string>
 #include <system_error>
+#include <vector>
 
+#include "tar/detail/fd.hpp"
+#include "tar/detail/sparse.hpp"
+
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/sysmacros.h>
 #include <sys/types.h>
-
-#include <grp.h>
-#include <pwd.h>
+#include <unistd.h>
 
 namespace tar {
 
-file_type type_from_std(std::filesystem::file_type t) {
-	using ft = std::filesystem::file_type;
+namespace {
 
-	switch(t) {
-	case ft::not_found:
-		throw std::ios_base::failure("file not found");
+std::size_t constexpr BufferSize = 64 * 1024;
 
-	case ft::regular:
+file_type type_from_mode(::mode_t m) {
+	switch(m & S_IFMT) {
+	case S_IFREG:
 		return file_type::regular;
-	case ft::symlink:
+	case S_IFLNK:
 		return file_type::symlink;
-	case ft::character:
+	case S_IFCHR:
 		return file_type::character;
-	case ft::block:
+	case S_IFBLK:
 		return file_type::block;
-	case ft::directory:
+	case S_IFDIR:
 		return file_type::directory;
-	case ft::fifo:
+	case S_IFIFO:
 		return file_type::fifo;
 
 	default:
@@ -42,15 +47,26 @@ file_type type_from_std(std::filesystem::file_type t) {
 	}
 }
 
-ostream& ostream::next(std::filesystem::path const& p, std::filesystem::path const& as) {
-	auto const status = std::filesystem::status(p);
-	auto const type   = type_from_std(status.type());
+}  // namespace
 
+header header_of(std::filesystem::path const& p, std::filesystem::path const& as) {
+	name_cache names;
+	return header_of(p, as, names);
+}
+
+header header_of(std::filesystem::path const& p, std::filesystem::path const& as, name_cache& names) {
+	file_id id;
+	return header_of(p, as, names, id);
+}
+
+header header_of(std::filesystem::path const& p, std::filesystem::path const& as, name_cache& names, file_id& id) {
 	struct ::stat info;
 	if(auto const ret = ::lstat(p.c_str(), &info); ret < 0) {
-		throw std::system_error(errno, std::generic_category(), std::strerror(errno));
+		detail::throw_errno();
 	}
 
+	auto const type = type_from_mode(info.st_mode);
+
 	std::filesystem::path link;
 	if(type == file_type::symlink) {
 		link = std::filesystem::read_symlink(p);
@@ -58,36 +74,125 @@ ostream& ostream::next(std::filesystem::path const& p, std::filesystem::path con
 
 	header h{
 	    .path        = as.empty() ? p : as,
-	    .permissions = status.permissions(),
+	    .permissions = static_cast<std::filesystem::perms>(info.st_mode & 07777),
+
+	    .uid = info.st_uid,
+	    .gid = info.st_gid,
 
-	    .uid  = info.st_uid,
-	    .gid  = info.st_gid,
-	    .size = std::filesystem::file_size(p),
+	    // Only regular files have a body.
+	    .size = (type == file_type::regular) ? static_cast<std::uintmax_t>(info.st_size) : 0,
 
 	    .last_write_time = std::filesystem::file_time_type(std::chrono::seconds(info.st_mtim.tv_sec)),
 
 	    .type = type,
 	    .link = link,
 
-	    .device_number_major = major(info.st_dev),
-	    .device_number_minor = minor(info.st_dev),
+	    .device_number_major = major(info.st_rdev),
+	    .device_number_minor = minor(info.st_rdev),
 	};
-	if(auto const* v = ::getpwuid(info.st_uid); v != nullptr) {
-		h.user_name = v->pw_name;
-	}
-	if(auto const* v = ::getgrgid(info.st_gid); v != nullptr) {
-		h.group_name = v->gr_name;
-	}
 
-	this->next(h);
-	if(type == file_type::symlink) {
+	h.user_name  = names.user_name(info.st_uid);
+	h.group_name = names.group_name(info.st_gid);
+
+	id = file_id{
+	    .device = info.st_dev,
+	    .inode  = info.st_ino,
+	    .links  = info.st_nlink,
+	};
+
+	return h;
+}
+
+ostream& ostream::next(std::filesystem::path const& p, std::filesystem::path const& as) {
+	file_id    id;
+	auto const h = header_of(p, as, *this->names_, id);
+	if(this->next_link(h, id)) {
 		return *this;
 	}
+	if(h.size == 0) {
+		this->next(h, 0);
+		return *this;
+	}
+
+	detail::unique_fd const f(::open(p.c_str(), O_RDONLY | O_CLOEXEC));
 
-	std::ifstream f(p, std::ios::binary);
-	*this << f.rdbuf();
+	auto const extents = detail::data_extents(f.get(), h.size);
+
+	// Copies no more than the size written in the header even if the file grows meanwhile.
+	std::uintmax_t expected = detail::data_size(extents);
+	std::uintmax_t written  = 0;
+	if(expected < h.size && this->next_sparse(h, extents)) {
+		written = this->write_from(f.get(), extents);
+	} else {
+		this->next(h, h.size);
+		expected = h.size;
+		written  = this->write_from(f.get(), h.size);
+	}
+	if(written != expected) [[unlikely]] {
+		throw std::system_error(std::make_error_code(std::errc::io_error), "file shrank while being read: " + p.string());
+	}
 
 	return *this;
 }
 
+bool ostream::next_link(header const& h, file_id const& id) {
+	if(!this->links_ || h.type == file_type::directory) {
+		return false;
+	}
+
+	auto const* target = this->links_->find_or_insert(id, h.path);
+	if(target == nullptr || !this->can_link_to_(*target)) {
+		return false;
+	}
+
+	auto link = h;
+	link.type = file_type::hard;
+	link.link = *target;
+	link.size = 0;
+	this->next(link, 0);
+
+	return true;
+}
+
+std::uintmax_t ostream::write_from(int fd, std::uintmax_t n) {
+	auto done = this->transfer_(fd, n);
+	if(done == n) {
+		return done;
+	}
+
+	std::vector<char> buf(std::min<std::uintmax_t>(n - done, BufferSize));
+	while(done < n) {
+		auto const l = detail::read_full(fd, buf.data(), std::min<std::uintmax_t>(buf.size(), n - done));
+		if(l == 0) {
+			break;
+		}
+
+		this->write(buf.data(), static_cast<std::streamsize>(l));
+		done += l;
+	}
+
+	return done;
+}
+
+std::uintmax_t ostream::write_from(int fd, std::span<extent const> extents) {
+	std::uintmax_t done = 0;
+	for(auto const& e: extents) {
+		if(e.size == 0) {
+			continue;
+		}
+		if(::lseek(fd, static_cast<::off_t>(e.offset), SEEK_SET) < 0) {
+			detail::throw_errno();
+		}
+
+		auto const l = this->write_from(fd, e.size);
+
+		done += l;
+		if(l != e.size) {
+			break;
+		}
+	}
+
+	return done;
+}
+
 }  // namespace tar
@@ -0,0 +1,20 @@
+#include "tar/links.hpp"
+
+#include <filesystem>
+
+namespace tar {
+
+std::filesystem::path const* link_map::find_or_insert(file_id const& id, std::filesystem::path const& p) {
+	if(id.links < 2) {
+		return nullptr;
+	}
+
+	auto const [it, inserted] = this->paths_.try_emplace(key{.device = id.device, .inode = id.inode}, p);
+	if(inserted) {
+		return nullptr;
+	}
+
+	return &it->second;
+}
+
+}  // namespace tar
@@ -0,0 +1,212 @@
+#include "tar/mapped.hpp"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include "tar/detail/marshal.hpp"
+#include "tar/detail/pax.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tar {
+namespace ustar {
+
+namespace {
+
+int advice_of(mapped_archive::access hint) {
+	switch(hint) {
+	case mapped_archive::access::sequential:
+		return MADV_SEQUENTIAL;
+	case mapped_archive::access::random:
+		return MADV_RANDOM;
+
+	default:
+		return MADV_NORMAL;
+	}
+}
+
+[[noreturn]] void throw_malformed(char const* what) {
+	throw std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), what);
+}
+
+std::string_view view_of(std::span<std::byte const> v) {
+	return std::string_view(reinterpret_cast<char const*>(v.data()), v.size());
+}
+
+}  // namespace
+
+std::string mapped_archive::entry::path() const {
+	if(!this->records.empty()) {
+		if(auto pax = detail::read_pax_entry(view_of(this->records)); !pax.path.empty()) {
+			return std::move(pax.path);
+		}
+	}
+
+	header_view const v(this->header());
+	if(v.prefix().empty()) {
+		return std::string(v.name());
+	}
+
+	return std::string(v.prefix()) + '/' + std::string(v.name());
+}
+
+mapped_archive::iterator::iterator(mapped_archive const* archive, std::uint64_t offset)
+    : archive_(archive)
+    , entry_(archive->try_at_(offset)) { }
+
+mapped_archive::iterator& mapped_archive::iterator::operator++() {
+	auto const& e = *this->entry_;
+	this->entry_ = this->archive_->try_at_(e.offset + BlockSize + padded_size(e.body.size()));
+
+	return *this;
+}
+
+mapped_archive::mapped_archive(std::filesystem::path const& p, access hint) {
+	auto const fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0) {
+		throw std::system_error(errno, std::generic_category(), std::strerror(errno));
+	}
+
+	struct ::stat info;
+	if(auto const ret = ::fstat(fd, &info); ret < 0) {
+		auto const err = errno;
+		::close(fd);
+		throw std::system_error(err, std::generic_category(), std::strerror(err));
+	}
+
+	this->size_ = static_cast<std::size_t>(info.st_size);
+	if(this->size_ == 0) {
+		// Empty file cannot be mapped.
+		::close(fd);
+		return;
+	}
+
+	auto* const data = ::mmap(nullptr, this->size_, PROT_READ, MAP_SHARED, fd, 0);
+	auto const  err  = errno;
+	::close(fd);  // Mapping holds its own reference to the file.
+	if(data == MAP_FAILED) {
+		throw std::system_error(err, std::generic_category(), std::strerror(err));
+	}
+
+	this->data_ = static_cast<std::byte const*>(data);
+	this->advise(hint);
+}
+
+mapped_archive::mapped_archive(mapped_archive&& other)
+    : data_(std::exchange(other.data_, nullptr))
+    , size_(std::exchange(other.size_, 0)) { }
+
+mapped_archive::~mapped_archive() {
+	if(this->data_ != nullptr) {
+		::munmap(const_cast<std::byte*>(this->data_), this->size_);
+	}
+}
+
+mapped_archive& mapped_archive::operator=(mapped_archive&& other) {
+	std::swap(this->data_, other.data_);
+	std::swap(this->size_, other.size_);
+	return *this;
+}
+
+mapped_archive::entry mapped_archive::at(std::uint64_t offset) const {
+	auto e = this->try_at_(offset);
+	if(!e) {
+		throw std::system_error(std::make_error_code(std::errc::result_out_of_range), "no entry at given offset");
+	}
+
+	return *e;
+}
+
+void mapped_archive::advise(access hint) const {
+	if(this->data_ == nullptr) {
+		return;
+	}
+
+	// It is only a hint so failure is not an error.
+	::madvise(const_cast<std::byte*>(this->data_), this->size_, advice_of(hint));
+}
+
+void mapped_archive::prefetch(entry const& e) const {
+	if(e.body.empty()) {
+		return;
+	}
+
+	// `madvise` needs an address aligned to the page.
+	static auto const page_size = static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+
+	auto const begin = reinterpret_cast<std::uintptr_t>(e.body.data()) & ~(page_size - 1);
+	auto const end   = reinterpret_cast<std::uintptr_t>(e.body.data() + e.body.size());
+	::madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+}
+
+std::optional<mapped_archive::entry> mapped_archive::try_at_(std::uint64_t offset) const {
+	std::span<std::byte const> records;  // Of a PAX extended header, applied to the next header.
+	while(true) {
+		if((offset > this->size_) || (this->size_ - offset < BlockSize)) [[unlikely]] {
+			return std::nullopt;
+		}
+
+		auto const* const block = this->data_ + offset;
+		auto const&       h     = *reinterpret_cast<header const*>(block);
+		if(h.name[0] == '\0') [[unlikely]] {
+			// End of archive.
+			return std::nullopt;
+		}
+		if(!h.verify()) [[unlikely]] {
+			throw_malformed("header checksum mismatch");
+		}
+
+		std::uintmax_t size;
+		if(records.empty()) {
+			if(!detail::unmarshal_size(h.size, size)) [[unlikely]] {
+				throw_malformed("invalid size in header");
+			}
+		} else {
+			// Size may be given by the records; the mapping is read-only so they are applied to a copy.
+			auto fields = h;
+			if(!detail::apply_pax(view_of(records), fields)) [[unlikely]] {
+				throw_malformed("malformed PAX extended header");
+			}
+			if(!detail::unmarshal_size(fields.size, size)) [[unlikely]] {
+				throw_malformed("invalid size in header");
+			}
+		}
+
+		auto const body_offset = offset + BlockSize;
+		if(this->size_ - body_offset < size) [[unlikely]] {
+			throw std::system_error(std::make_error_code(std::errc::io_error), "archive is truncated");
+		}
+
+		if(h.typeflag == PaxExtended || h.typeflag == PaxGlobal) [[unlikely]] {
+			if(size > detail::MaxPaxSize) [[unlikely]] {
+				throw_malformed("PAX extended header too large");
+			}
+
+			// Global records are not supported and ignored.
+			records = h.typeflag == PaxExtended ? std::span<std::byte const>(block + BlockSize, size) : std::span<std::byte const>();
+			offset  = body_offset + padded_size(size);
+			continue;
+		}
+
+		return entry{
+		    .block   = std::span<std::byte const, BlockSize>(block, BlockSize),
+		    .body    = std::span<std::byte const>(block + BlockSize, size),
+		    .offset  = offset,
+		    .records = records,
+		};
+	}
+}
+
+}  // namespace ustar
+}  // namespace tar
@@ -0,0 +1,310 @@
+#include "tar/mapped_index.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "tar/detail/fd.hpp"
+#include "tar/fdbuf.hpp"
+#include "tar/index.hpp"
+#include "tar/ustar.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Layout of the file, in the byte order of the machine and aligned so it can be used in place:
+//
+//   `file_header`
+//   `index::entry` for each entry, in the order of the archive
+//   u32 position of each entry, ordered by path
+//   path table
+
+namespace tar {
+namespace ustar {
+
+namespace {
+
+std::string_view constexpr Magic = "TARIDXM1";
+
+// Tells the file was written on a machine of the same byte order.
+std::uint32_t constexpr ByteOrderMark = 0x01020304;
+
+// Scans of an archive that keeps changing before giving up.
+int constexpr MaxScanAttempts = 3;
+
+struct file_header {
+	char          magic[8];
+	std::uint32_t version;
+	std::uint32_t byte_order;
+	std::uint32_t entry_size;
+	std::uint32_t reserved;
+
+	std::uint64_t archive_size;
+	std::int64_t  archive_mtime_sec;
+	std::int64_t  archive_mtime_nsec;
+
+	std::uint64_t entry_count;
+	std::uint64_t paths_size;
+};
+
+static_assert(sizeof(file_header) == 64);
+static_assert(alignof(index::entry) <= alignof(file_header));
+static_assert(sizeof(index::entry) % alignof(std::uint32_t) == 0);
+static_assert(std::is_trivially_copyable_v<index::entry>);
+
+[[noreturn]] void throw_malformed() {
+	throw std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), "malformed index");
+}
+
+struct ::stat stat_of(std::filesystem::path const& p) {
+	struct ::stat info;
+	if(::stat(p.c_str(), &info) < 0) {
+		detail::throw_errno();
+	}
+
+	return info;
+}
+
+struct ::stat stat_of(int fd) {
+	struct ::stat info;
+	if(::fstat(fd, &info) < 0) {
+		detail::throw_errno();
+	}
+
+	return info;
+}
+
+bool same_stamp(struct ::stat const& a, struct ::stat const& b) {
+	return a.st_size == b.st_size && a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
+
+// Writes `idx` to `p`, stamped with the size and modification time in `info`.
+void write_index(index const& idx, struct ::stat const& info, std::filesystem::path const& p) {
+	std::vector<std::uint32_t> sorted(idx.size());
+	std::iota(sorted.begin(), sorted.end(), 0);
+	std::ranges::stable_sort(sorted, {}, [&](std::uint32_t i) { return idx.path(idx.entries()[i]); });
+
+	std::size_t paths_size = 0;
+	for(auto const& e: idx.entries()) {
+		paths_size += e.path_size;
+	}
+
+	// Zeroed so padding bytes are written deterministically.
+	std::string data(sizeof(file_header) + idx.size() * (sizeof(index::entry) + sizeof(std::uint32_t)) + paths_size, '\0');
+
+	file_header h{};
+	std::memcpy(h.magic, Magic.data(), Magic.size());
+	h.version            = mapped_index::Version;
+	h.byte_order         = ByteOrderMark;
+	h.entry_size         = sizeof(index::entry);
+	h.archive_size       = static_cast<std::uint64_t>(info.st_size);
+	h.archive_mtime_sec  = info.st_mtim.tv_sec;
+	h.archive_mtime_nsec = info.st_mtim.tv_nsec;
+	h.entry_count        = idx.size();
+	h.paths_size         = paths_size;
+	std::memcpy(data.data(), &h, sizeof(h));
+
+	auto* entries = data.data() + sizeof(file_header);
+	auto* paths   = entries + idx.size() * (sizeof(index::entry) + sizeof(std::uint32_t));
+
+	std::uint32_t path_offset = 0;
+	for(auto const& e: idx.entries()) {
+		index::entry r;
+		std::memset(&r, 0, sizeof(r));
+		r.header_offset = e.header_offset;
+		r.body_offset   = e.body_offset;
+		r.size          = e.size;
+		r.real_size     = e.real_size;
+		r.path_offset   = path_offset;
+		r.path_size     = e.path_size;
+		r.type          = e.type;
+		r.sparse        = e.sparse;
+		std::memcpy(entries, &r, sizeof(r));
+		entries += sizeof(r);
+
+		auto const path = idx.path(e);
+		std::memcpy(paths + path_offset, path.data(), path.size());
+		path_offset += e.path_size;
+	}
+	std::memcpy(entries, sorted.data(), sorted.size() * sizeof(std::uint32_t));
+
+	auto temp = p;
+	temp += ".tmp." + std::to_string(::getpid());
+	{
+		detail::unique_fd const fd(::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+		try {
+			detail::write_full(fd.get(), data.data(), data.size());
+		} catch(...) {
+			::unlink(temp.c_str());
+			throw;
+		}
+	}
+	std::filesystem::rename(temp, p);
+}
+
+}  // namespace
+
+void mapped_index::write(index const& idx, std::filesystem::path const& archive, std::filesystem::path const& p) {
+	write_index(idx, stat_of(archive), p);
+}
+
+mapped_index::mapped_index(std::filesystem::path const& p, std::filesystem::path const& archive) {
+	{
+		detail::unique_fd const fd(::open(p.c_str(), O_RDONLY | O_CLOEXEC));
+
+		struct ::stat info;
+		if(::fstat(fd.get(), &info) < 0) {
+			detail::throw_errno();
+		}
+		if(static_cast<std::size_t>(info.st_size) < sizeof(file_header)) {
+			throw_malformed();
+		}
+
+		auto* const data = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_SHARED, fd.get(), 0);
+		if(data == MAP_FAILED) {
+			detail::throw_errno();
+		}
+
+		// Mapping holds its own reference to the file.
+		this->data_ = static_cast<std::byte const*>(data);
+		this->size_ = static_cast<std::size_t>(info.st_size);
+	}
+
+	try {
+		auto const& h = *reinterpret_cast<file_header const*>(this->data_);
+		if(std::string_view(h.magic, sizeof(h.magic)) != Magic) {
+			throw_malformed();
+		}
+		if(h.version != Version || h.byte_order != ByteOrderMark || h.entry_size != sizeof(index::entry)) {
+			throw std::system_error(std::make_error_code(std::errc::not_supported), "index of another version or layout");
+		}
+
+		// Only the sizes are checked so opening does not touch the tables;
+		// paths are checked when they are read.
+		auto const rest = this->size_ - sizeof(file_header);
+		if(h.entry_count > rest / (sizeof(index::entry) + sizeof(std::uint32_t))) {
+			throw_malformed();
+		}
+		auto const tables = h.entry_count * (sizeof(index::entry) + sizeof(std::uint32_t));
+		if(h.paths_size != rest - tables) {
+			throw_malformed();
+		}
+
+		auto const info = stat_of(archive);
+		if(static_cast<std::uint64_t>(info.st_size) != h.archive_size || info.st_mtim.tv_sec != h.archive_mtime_sec || info.st_mtim.tv_nsec != h.archive_mtime_nsec) {
+			throw std::system_error(std::make_error_code(std::errc::invalid_argument), "archive differs from the indexed one");
+		}
+
+		auto const* entries = this->data_ + sizeof(file_header);
+		auto const* sorted  = entries + h.entry_count * sizeof(index::entry);
+		auto const* paths   = sorted + h.entry_count * sizeof(std::uint32_t);
+
+		this->entries_ = std::span(reinterpret_cast<index::entry const*>(entries), h.entry_count);
+		this->sorted_  = std::span(reinterpret_cast<std::uint32_t const*>(sorted), h.entry_count);
+		this->paths_   = std::string_view(reinterpret_cast<char const*>(paths), h.paths_size);
+	} catch(...) {
+		::munmap(const_cast<std::byte*>(this->data_), this->size_);
+		throw;
+	}
+}
+
+mapped_index mapped_index::open_or_build(std::filesystem::path const& archive, std::filesystem::path const& p, bool verify_checksum) {
+	try {
+		return mapped_index(p, archive);
+	} catch(std::system_error const&) {
+		// Missing, stale, or unusable; written again below.
+	}
+
+	{
+		detail::unique_fd const fd(::open(archive.c_str(), O_RDONLY | O_CLOEXEC));
+
+		// Stamped with what was scanned, so an archive changed meanwhile is scanned again
+		// rather than recorded with the size and time of a later state.
+		for(int attempt = 0;; ++attempt) {
+			auto const before = stat_of(fd.get());
+			if(::lseek(fd.get(), 0, SEEK_SET) < 0) {
+				detail::throw_errno();
+			}
+
+			fdbuf       buf(fd.get(), BlockSize);
+			index const idx(&buf, verify_checksum);
+			if(same_stamp(before, stat_of(fd.get()))) {
+				write_index(idx, before, p);
+				break;
+			}
+			if(attempt == MaxScanAttempts - 1) {
+				throw std::system_error(std::make_error_code(std::errc::resource_unavailable_try_again), "archive changed while it was indexed");
+			}
+		}
+	}
+
+	return mapped_index(p, archive);
+}
+
+mapped_index::mapped_index(mapped_index&& other)
+    : data_(std::exchange(other.data_, nullptr))
+    , size_(std::exchange(other.size_, 0))
+    , entries_(std::exchange(other.entries_, {}))
+    , sorted_(std::exchange(other.sorted_, {}))
+    , paths_(std::exchange(other.paths_, {})) { }
+
+mapped_index::~mapped_index() {
+	if(this->data_ != nullptr) {
+		::munmap(const_cast<std::byte*>(this->data_), this->size_);
+	}
+}
+
+mapped_index& mapped_index::operator=(mapped_index&& other) {
+	std::swap(this->data_, other.data_);
+	std::swap(this->size_, other.size_);
+	std::swap(this->entries_, other.entries_);
+	std::swap(this->sorted_, other.sorted_);
+	std::swap(this->paths_, other.paths_);
+	return *this;
+}
+
+std::string_view mapped_index::path(index::entry const& e) const {
+	if(e.path_offset > this->paths_.size() || e.path_size > this->paths_.size() - e.path_offset) [[unlikely]] {
+		throw_malformed();
+	}
+
+	return this->paths_.substr(e.path_offset, e.path_size);
+}
+
+index::entry const* mapped_index::find(std::string_view path) const {
+	auto const path_at = [&](std::uint32_t i) {
+		if(i >= this->entries_.size()) [[unlikely]] {
+			throw_malformed();
+		}
+		return this->path(this->entries_[i]);
+	};
+
+	// Past the last entry with the path; the sort is stable so that is the last one in the archive.
+	auto const it = std::ranges::upper_bound(this->sorted_, path, {}, path_at);
+	if(it == this->sorted_.begin()) {
+		return nullptr;
+	}
+
+	auto const i = *std::prev(it);
+	if(path_at(i) != path) {
+		return nullptr;
+	}
+
+	return &this->entries_[i];
+}
+
+}  // namespace ustar
+}  // namespace tar
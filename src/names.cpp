@@ -0,0 +1,73 @@
+#include "tar/names.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <grp.h>
+#include <pwd.h>
+
+namespace tar {
+
+namespace {
+
+// Calls reentrant variant of `getpwuid` or `getgrgid` with a buffer large enough.
+template<typename T, typename Id, typename F>
+std::string name_of(Id id, int hint, F f, char* T::*name) {
+	auto const size = ::sysconf(hint);
+
+	std::vector<char> buf(size > 0 ? static_cast<std::size_t>(size) : 1024);
+	while(true) {
+		T  v;
+		T* result = nullptr;
+		if(auto const ret = f(id, &v, buf.data(), buf.size(), &result); ret == ERANGE) {
+			buf.resize(buf.size() * 2);
+			continue;
+		}
+		if(result == nullptr) {
+			return "";
+		}
+
+		return v.*name;
+	}
+}
+
+template<typename F>
+std::string const& lookup(std::shared_mutex& mutex, name_cache::map_type& names, std::uintmax_t id, F resolve) {
+	{
+		std::shared_lock lock(mutex);
+		if(auto const it = names.find(id); it != names.end()) [[likely]] {
+			return it->second;
+		}
+	}
+
+	// Resolved while holding the lock so each ID is resolved only once.
+	std::unique_lock lock(mutex);
+	if(auto const it = names.find(id); it != names.end()) {
+		return it->second;
+	}
+
+	return names.emplace(id, resolve(id)).first->second;
+}
+
+}  // namespace
+
+std::string const& name_cache::user_name(std::uintmax_t uid) {
+	return lookup(this->mutex_, this->users_, uid, [](std::uintmax_t id) {
+		return name_of<::passwd>(static_cast<::uid_t>(id), _SC_GETPW_R_SIZE_MAX, ::getpwuid_r, &::passwd::pw_name);
+	});
+}
+
+std::string const& name_cache::group_name(std::uintmax_t gid) {
+	return lookup(this->mutex_, this->groups_, gid, [](std::uintmax_t id) {
+		return name_of<::group>(static_cast<::gid_t>(id), _SC_GETGR_R_SIZE_MAX, ::getgrgid_r, &::group::gr_name);
+	});
+}
+
+}  // namespace tar
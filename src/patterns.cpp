@@ -0,0 +1,424 @@
+#include "tar/patterns.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace tar {
+
+namespace {
+
+// Set of states of a tail, one for each position in it and one for its end.
+class states {
+   public:
+	static constexpr std::size_t WordCount = (pattern_set::MaxTailSize + 1 + 63) / 64;
+
+	// Only words holding states up to `size` are visited.
+	explicit states(std::size_t size)
+	    : count_(size / 64 + 1) { }
+
+	void set(std::size_t s) {
+		this->words_[s / 64] |= std::uint64_t(1) << (s % 64);
+	}
+
+	bool test(std::size_t s) const {
+		return (this->words_[s / 64] >> (s % 64)) & 1;
+	}
+
+	bool none() const {
+		return std::all_of(this->words_.begin(), this->words_.begin() + this->count_, [](std::uint64_t w) { return w == 0; });
+	}
+
+	// Calls `f` with each state in ascending order, including ones set by `f` ahead of the current one.
+	template<typename F>
+	void for_each(F&& f) {
+		for(std::size_t w = 0; w < this->count_; ++w) {
+			std::uint64_t done = 0;
+			while(auto const bits = this->words_[w] & ~done) {
+				auto const b = std::countr_zero(bits);
+				done |= std::uint64_t(1) << b;
+				f(w * 64 + static_cast<std::size_t>(b));
+			}
+		}
+	}
+
+   private:
+	std::size_t                          count_;
+	std::array<std::uint64_t, WordCount> words_{};
+};
+
+[[noreturn]] void throw_malformed(std::string_view pattern) {
+	throw std::system_error(std::make_error_code(std::errc::invalid_argument), "malformed pattern: " + std::string(pattern));
+}
+
+bool is_wildcard(char c) {
+	return c == '*' || c == '?' || c == '[';
+}
+
+}  // namespace
+
+// Path given whole or as the prefix and the name of a header, joined by '/' if the prefix is not empty.
+class pattern_set::path_ref {
+   public:
+	explicit path_ref(std::string_view path)
+	    : tail_(path) { }
+
+	path_ref(std::string_view prefix, std::string_view name)
+	    : head_(prefix)
+	    , tail_(name)
+	    , sep_(prefix.empty() ? 0 : 1) { }
+
+	std::size_t size() const {
+		return this->head_.size() + this->sep_ + this->tail_.size();
+	}
+
+	char operator[](std::size_t i) const {
+		if(i < this->head_.size()) {
+			return this->head_[i];
+		}
+		i -= this->head_.size();
+		if(i < this->sep_) {
+			return '/';
+		}
+		return this->tail_[i - this->sep_];
+	}
+
+   private:
+	std::string_view head_;
+	std::string_view tail_;
+	std::size_t      sep_ = 0;
+};
+
+void pattern_set::add_(std::string_view pattern, bool exclude) {
+	if(pattern.empty()) {
+		throw_malformed(pattern);
+	}
+
+	// Matches a directory as it would without the '/', as paths match up to a '/'.
+	while(pattern.size() > 1 && pattern.back() == '/' && pattern[pattern.size() - 2] != '\\') {
+		pattern.remove_suffix(1);
+	}
+
+	// Literal prefix into the trie.
+	std::uint32_t n = 0;
+	std::size_t   i = 0;
+	while(i < pattern.size() && !is_wildcard(pattern[i])) {
+		auto c = pattern[i++];
+		if(c == '\\') {
+			if(i == pattern.size()) {
+				throw_malformed(pattern);
+			}
+			c = pattern[i++];
+		}
+
+		auto next = this->child_(n, c);
+		if(next == 0) {
+			next = static_cast<std::uint32_t>(this->nodes_.size());
+
+			auto& children = this->nodes_[n].children;
+			auto  it       = std::ranges::lower_bound(children, c, {}, &std::pair<char, std::uint32_t>::first);
+			children.insert(it, {c, next});
+			this->nodes_.emplace_back();
+		}
+		n = next;
+	}
+
+	auto& count = exclude ? this->excludes_ : this->includes_;
+	if(i == pattern.size()) {
+		(exclude ? this->nodes_[n].exclude : this->nodes_[n].include) = true;
+		++count;
+		return;
+	}
+
+	// The rest into elements of a tail.
+	auto const begin = this->elements_.size();
+	while(i < pattern.size()) {
+		auto const c = pattern[i++];
+		switch(c) {
+		case '\\':
+			if(i == pattern.size()) {
+				throw_malformed(pattern);
+			}
+			this->elements_.push_back({.kind = op::literal, .c = pattern[i++]});
+			break;
+
+		case '*':
+			if(i < pattern.size() && pattern[i] == '*') {
+				++i;
+				if(i < pattern.size() && pattern[i] == '/') {
+					++i;
+					this->elements_.push_back({.kind = op::any_dirs});
+					this->elements_.push_back({.kind = op::in_dirs});
+				} else {
+					this->elements_.push_back({.kind = op::star_all});
+				}
+			} else {
+				this->elements_.push_back({.kind = op::star});
+			}
+			break;
+
+		case '?':
+			this->elements_.push_back({.kind = op::one});
+			break;
+
+		case '[': {
+			std::bitset<256> s;
+
+			bool const negated = i < pattern.size() && (pattern[i] == '!' || pattern[i] == '^');
+			if(negated) {
+				++i;
+			}
+
+			bool closed = false;
+			bool first  = true;
+			while(i < pattern.size()) {
+				auto lo = pattern[i++];
+				if(lo == ']' && !first) {
+					closed = true;
+					break;
+				}
+				first = false;
+				if(lo == '\\' && i < pattern.size()) {
+					lo = pattern[i++];
+				}
+
+				auto hi = lo;
+				if(i + 1 < pattern.size() && pattern[i] == '-' && pattern[i + 1] != ']') {
+					hi = pattern[i + 1];
+					i += 2;
+					if(hi == '\\' && i < pattern.size()) {
+						hi = pattern[i++];
+					}
+				}
+				for(auto x = static_cast<unsigned char>(lo); x <= static_cast<unsigned char>(hi); ++x) {
+					s.set(x);
+					if(x == 255) {
+						break;
+					}
+				}
+			}
+			if(!closed) {
+				throw_malformed(pattern);
+			}
+			if(negated) {
+				s.flip();
+			}
+			// Matches a character within a component only, as `?` does.
+			s.reset('/');
+
+			this->elements_.push_back({.kind = op::set, .set = static_cast<std::uint32_t>(this->sets_.size())});
+			this->sets_.push_back(s);
+			break;
+		}
+
+		default:
+			this->elements_.push_back({.kind = op::literal, .c = c});
+			break;
+		}
+	}
+
+	auto const size = this->elements_.size() - begin;
+	if(size > MaxTailSize) {
+		this->elements_.resize(begin);
+		throw std::system_error(std::make_error_code(std::errc::invalid_argument), "pattern too long: " + std::string(pattern));
+	}
+
+	std::size_t suffix = 0;
+	while(suffix < size && this->elements_[this->elements_.size() - suffix - 1].kind == op::literal) {
+		++suffix;
+	}
+
+	this->nodes_[n].tails.push_back(static_cast<std::uint32_t>(this->tails_.size()));
+	this->tails_.push_back({
+	    .begin   = static_cast<std::uint32_t>(begin),
+	    .size    = static_cast<std::uint32_t>(size),
+	    .suffix  = static_cast<std::uint32_t>(suffix),
+	    .exclude = exclude,
+	});
+	++count;
+}
+
+std::uint32_t pattern_set::child_(std::uint32_t n, char c) const {
+	auto const& children = this->nodes_[n].children;
+
+	auto const it = std::ranges::lower_bound(children, c, {}, &std::pair<char, std::uint32_t>::first);
+	if(it == children.end() || it->first != c) {
+		return 0;
+	}
+
+	return it->second;
+}
+
+bool pattern_set::matches_(tail const& t, path_ref const& p, std::size_t offset) const {
+	auto const* const elements = this->elements_.data() + t.begin;
+	auto const        n        = p.size();
+
+	// A match ends at the end of the path or before a '/', right after the literals ending the tail.
+	if(t.suffix > 0) {
+		auto const* const suffix = elements + t.size - t.suffix;
+
+		bool found = false;
+		for(auto i = offset + t.suffix; i <= n && !found; ++i) {
+			if(i < n && p[i] != '/') {
+				continue;
+			}
+
+			found = true;
+			for(std::size_t k = 0; k < t.suffix; ++k) {
+				if(p[i - t.suffix + k] != suffix[k].c) {
+					found = false;
+					break;
+				}
+			}
+		}
+		if(!found) {
+			return false;
+		}
+	}
+
+	// Follows the transitions that consume nothing.
+	auto const close = [&](states& s) {
+		s.for_each([&](std::size_t i) {
+			if(i < t.size) {
+				switch(elements[i].kind) {
+				case op::star:
+				case op::star_all:
+					s.set(i + 1);
+					break;
+				case op::any_dirs:
+					// No directory; skips `in_dirs`.
+					s.set(i + 2);
+					break;
+				default:
+					break;
+				}
+			}
+		});
+	};
+
+	states current(t.size);
+	current.set(0);
+	close(current);
+
+	for(auto i = offset;; ++i) {
+		if(current.test(t.size) && (i == n || p[i] == '/')) {
+			return true;
+		}
+		if(i == n) {
+			return false;
+		}
+
+		auto const c = p[i];
+
+		states next(t.size);
+		current.for_each([&](std::size_t s) {
+			if(s == t.size) {
+				return;
+			}
+
+			auto const& e = elements[s];
+			switch(e.kind) {
+			case op::literal:
+				if(c == e.c) {
+					next.set(s + 1);
+				}
+				break;
+			case op::one:
+				if(c != '/') {
+					next.set(s + 1);
+				}
+				break;
+			case op::set:
+				if(this->sets_[e.set].test(static_cast<unsigned char>(c))) {
+					next.set(s + 1);
+				}
+				break;
+			case op::star:
+				if(c != '/') {
+					next.set(s);
+				}
+				break;
+			case op::star_all:
+				next.set(s);
+				break;
+			case op::any_dirs:
+				next.set(s + 1);
+				if(c == '/') {
+					next.set(s + 2);
+				}
+				break;
+			case op::in_dirs:
+				next.set(s);
+				if(c == '/') {
+					next.set(s + 1);
+				}
+				break;
+			}
+		});
+		if(next.none()) {
+			return false;
+		}
+
+		close(next);
+		current = next;
+	}
+}
+
+bool pattern_set::selects_(path_ref const& p) const {
+	bool included = this->includes_ == 0;
+
+	std::uint32_t n = 0;
+	for(std::size_t d = 0;; ++d) {
+		auto const& x = this->nodes_[n];
+		if(d == p.size() || p[d] == '/') {
+			if(x.exclude) {
+				return false;
+			}
+			if(x.include) {
+				included = true;
+			}
+		}
+		for(auto const i: x.tails) {
+			auto const& t = this->tails_[i];
+			if(!t.exclude && included) {
+				// Already known.
+				continue;
+			}
+			if(!this->matches_(t, p, d)) {
+				continue;
+			}
+			if(t.exclude) {
+				return false;
+			}
+			included = true;
+		}
+		if(included && this->excludes_ == 0) {
+			return true;
+		}
+
+		if(d == p.size()) {
+			break;
+		}
+		n = this->child_(n, p[d]);
+		if(n == 0) {
+			break;
+		}
+	}
+
+	return included;
+}
+
+bool pattern_set::selects(std::string_view path) const {
+	return this->selects_(path_ref(path));
+}
+
+bool pattern_set::selects(ustar::header_view const& h) const {
+	return this->selects_(path_ref(h.prefix(), h.name()));
+}
+
+}  // namespace tar
@@ -0,0 +1,96 @@
+#include "tar/detail/pax.hpp"
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "tar/detail/marshal.hpp"
+#include "tar/ustar.hpp"
+
+namespace tar {
+namespace detail {
+
+namespace {
+
+bool parse(std::string_view v, std::uintmax_t& out) {
+	auto const [p, ec] = std::from_chars(v.data(), v.data() + v.size(), out);
+	return ec == std::errc() && p == v.data() + v.size();
+}
+
+// Only the integral part is taken, e.g. "-12" of "-12.5" which is a time before the epoch.
+bool parse(std::string_view v, std::intmax_t& out) {
+	auto const [p, ec] = std::from_chars(v.data(), v.data() + v.size(), out);
+	return ec == std::errc() && (p == v.data() + v.size() || *p == '.');
+}
+
+template<typename T, std::size_t N>
+bool override(std::string_view value, std::array<char, N>& field) {
+	T v;
+	if(!parse(value, v)) {
+		return false;
+	}
+
+	marshal(v, field);
+	return true;
+}
+
+}  // namespace
+
+std::string pax_record(std::string_view key, std::string_view value) {
+	// Length includes the digits of itself.
+	auto const content = key.size() + value.size() + 3;  // ' ', '=', and '\n'.
+
+	auto n = content + 1;
+	while(std::to_string(n).size() + content != n) {
+		n = std::to_string(n).size() + content;
+	}
+
+	std::string record = std::to_string(n);
+	record += ' ';
+	record += key;
+	record += '=';
+	record += value;
+	record += '\n';
+
+	return record;
+}
+
+pax_entry read_pax_entry(std::string_view records) {
+	pax_entry e;
+	for_each_pax_record(records, [&](std::string_view key, std::string_view value) {
+		if(key == "path" || key == "GNU.sparse.name") {
+			e.path = value;
+		} else if(key == "GNU.sparse.major") {
+			e.sparse = value == "1";
+		} else if(key == "GNU.sparse.realsize") {
+			std::from_chars(value.data(), value.data() + value.size(), e.real_size);
+		}
+	});
+
+	return e;
+}
+
+bool apply_pax(std::string_view records, ustar::header& h) {
+	bool ok = true;
+
+	auto const is_valid = for_each_pax_record(records, [&](std::string_view key, std::string_view value) {
+		if(key == "size") {
+			ok = override<std::uintmax_t>(value, h.size) && ok;
+		} else if(key == "uid") {
+			ok = override<std::uintmax_t>(value, h.uid) && ok;
+		} else if(key == "gid") {
+			ok = override<std::uintmax_t>(value, h.gid) && ok;
+		} else if(key == "mtime") {
+			ok = override<std::intmax_t>(value, h.mtime) && ok;
+		}
+	});
+
+	return is_valid && ok;
+}
+
+}  // namespace detail
+}  // namespace tar
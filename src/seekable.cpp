@@ -0,0 +1,353 @@
+#include "tar/seekable.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ios>
+#include <memory>
+#include <span>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "tar/compress.hpp"
+#include "tar/ustar.hpp"
+
+// Layout of the seek table, all integers in little-endian:
+//
+//   u64 number of frames, followed by each frame:
+//     u64 offset in the compressed stream
+//     u64 offset of its content in the uncompressed stream
+//   u64 number of entries, followed by each entry:
+//     u64 offset of the header in the uncompressed stream
+//     u32 size of the path
+//     path
+//
+// The table is split into gzip members without content each carrying a part in its extra field (subfield "TS"),
+// or into zstd skippable frames. It is followed by a trailer of fixed size (subfield "TT" for gzip)
+// that holds `TrailerMagic`, the offset of the table in the compressed stream, and the size of the table.
+
+namespace tar {
+
+namespace {
+
+std::string_view constexpr TrailerMagic = "TARSEEK1";
+
+std::size_t constexpr TrailerPayloadSize = TrailerMagic.size() + 8 + 8;
+
+// Extra field of gzip is limited to 65535 bytes including the subfield header.
+std::size_t constexpr MaxGzipPayloadSize = 65535 - 4;
+
+std::size_t constexpr GzipHeaderSize  = 10 + 2 + 4;  // Header, XLEN, and subfield header.
+std::size_t constexpr GzipTrailerSize = 2 + 4 + 4;   // Empty deflate stream, CRC32, and ISIZE.
+
+std::uint32_t constexpr ZstdSkippableMagic = 0x184D2A5E;
+
+std::size_t constexpr ZstdHeaderSize = 4 + 4;
+
+void put(std::string& dst, std::uint64_t v, std::size_t n) {
+	for(std::size_t i = 0; i < n; ++i) {
+		dst.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+	}
+}
+
+std::uint64_t get(std::string_view& src, std::size_t n) {
+	if(src.size() < n) [[unlikely]] {
+		throw std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), "malformed seek table");
+	}
+
+	std::uint64_t v = 0;
+	for(std::size_t i = 0; i < n; ++i) {
+		v |= std::uint64_t(static_cast<std::uint8_t>(src[i])) << (8 * i);
+	}
+
+	src.remove_prefix(n);
+	return v;
+}
+
+// Wraps `payload` in a unit which decompresses to nothing.
+std::string wrap(codec c, std::array<char, 2> id, std::string_view payload) {
+	std::string v;
+	if(c == codec::zstd) {
+		put(v, ZstdSkippableMagic, 4);
+		put(v, payload.size(), 4);
+		v += payload;
+		return v;
+	}
+
+	// ID1, ID2, CM (deflate), FLG (FEXTRA), MTIME, XFL, and OS (unknown).
+	v += std::string_view("\x1F\x8B\x08\x04\x00\x00\x00\x00\x00\xFF", 10);
+	put(v, payload.size() + 4, 2);
+	v += std::string_view(id.data(), id.size());
+	put(v, payload.size(), 2);
+	v += payload;
+
+	// Deflate stream of nothing, and CRC32 and size of nothing.
+	v += std::string_view("\x03\x00\x00\x00\x00\x00\x00\x00\x00\x00", GzipTrailerSize);
+	return v;
+}
+
+std::size_t wrapped_size(codec c, std::size_t payload_size) {
+	return payload_size + (c == codec::zstd ? ZstdHeaderSize : GzipHeaderSize + GzipTrailerSize);
+}
+
+void read_exact(std::streambuf* src, char* buf, std::size_t n) {
+	if(src->sgetn(buf, static_cast<std::streamsize>(n)) != static_cast<std::streamsize>(n)) [[unlikely]] {
+		throw std::system_error(std::make_error_code(std::errc::io_error), "archive is truncated");
+	}
+}
+
+// Reads a unit written by `wrap` and returns its payload.
+std::string unwrap(std::streambuf* src, codec c, std::array<char, 2> id) {
+	auto const invalid = [] {
+		return std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), "no seek table");
+	};
+
+	std::string header(c == codec::zstd ? ZstdHeaderSize : GzipHeaderSize, '\0');
+	read_exact(src, header.data(), header.size());
+
+	std::string_view h = header;
+	std::size_t      size;
+	if(c == codec::zstd) {
+		if(get(h, 4) != ZstdSkippableMagic) {
+			throw invalid();
+		}
+		size = get(h, 4);
+	} else {
+		if(!h.starts_with(std::string_view("\x1F\x8B\x08\x04", 4))) {
+			throw invalid();
+		}
+		h.remove_prefix(10);
+
+		auto const xlen = get(h, 2);
+		if(h.substr(0, 2) != std::string_view(id.data(), id.size())) {
+			throw invalid();
+		}
+		h.remove_prefix(2);
+
+		size = get(h, 2);
+		if(xlen != size + 4) {
+			throw invalid();
+		}
+	}
+
+	std::string payload(size, '\0');
+	read_exact(src, payload.data(), payload.size());
+	if(c == codec::gzip) {
+		std::array<char, GzipTrailerSize> trailer;
+		read_exact(src, trailer.data(), trailer.size());
+	}
+
+	return payload;
+}
+
+}  // namespace
+
+namespace detail {
+
+seekable_ostream_base::seekable_ostream_base(std::streambuf* dst, compress_options const& options)
+    : dst_(dst)
+    , compressor_(dst, options) { }
+
+seekable_ostream_base::~seekable_ostream_base() {
+	try {
+		this->compressor_.finish();
+
+		auto const c      = this->compressor_.codec();
+		auto const frames = this->compressor_.frames();
+
+		std::string table;
+		put(table, frames.size(), 8);
+		for(auto const& f: frames) {
+			put(table, f.offset, 8);
+			put(table, f.uncompressed_offset, 8);
+		}
+		put(table, this->entry_count_, 8);
+		table += this->entries_;
+
+		std::string out;
+		for(std::size_t i = 0; i < table.size(); i += MaxGzipPayloadSize) {
+			out += wrap(c, {'T', 'S'}, std::string_view(table).substr(i, MaxGzipPayloadSize));
+		}
+
+		std::string trailer(TrailerMagic);
+		put(trailer, this->compressor_.compressed_size(), 8);
+		put(trailer, table.size(), 8);
+		out += wrap(c, {'T', 'T'}, trailer);
+
+		this->dst_->sputn(out.data(), static_cast<std::streamsize>(out.size()));
+		this->dst_->pubsync();
+	} catch(...) {
+	}
+}
+
+void seekable_ostream_base::start_entry_(std::string_view path) {
+	this->compressor_.cut();
+
+	put(this->entries_, static_cast<std::uint64_t>(this->compressor_.pubseekoff(0, std::ios_base::cur, std::ios_base::out)), 8);
+	put(this->entries_, path.size(), 4);
+	this->entries_ += path;
+	++this->entry_count_;
+}
+
+seekable_istream_base::seekable_istream_base(std::streambuf* src, codec c, std::uint64_t skip)
+    : decompressor_(src, c) {
+	std::array<char, 4096> discard;
+	while(skip > 0) {
+		auto const n = std::min<std::uint64_t>(skip, discard.size());
+		read_exact(&this->decompressor_, discard.data(), n);
+		skip -= n;
+	}
+}
+
+}  // namespace detail
+
+namespace ustar {
+
+namespace {
+
+class seekable_istream: private detail::seekable_istream_base, public istream {
+   public:
+	seekable_istream(std::streambuf* src, codec c, std::uint64_t skip)
+	    : detail::seekable_istream_base(src, c, skip)
+	    , istream(&this->decompressor_) { }
+};
+
+}  // namespace
+
+seekable_ostream::seekable_ostream(std::streambuf* dst, compress_options const& options)
+    : detail::seekable_ostream_base(dst, options)
+    , ostream(&this->compressor_) { }
+
+void seekable_ostream::begin_entry_(std::string_view path, bool size_known) {
+	if(!size_known) [[unlikely]] {
+		throw std::system_error(std::make_error_code(std::errc::invalid_seek), "size of an entry must be known in a seekable archive");
+	}
+
+	this->start_entry_(path);
+}
+
+seekable_archive::seekable_archive(std::streambuf* src)
+    : src_(src) {
+	auto const invalid = [] {
+		return std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), "no seek table");
+	};
+
+	this->base_ = src->pubseekoff(0, std::ios_base::cur, std::ios_base::in);
+	if(this->base_ < 0) [[unlikely]] {
+		throw std::system_error(std::make_error_code(std::errc::invalid_seek));
+	}
+
+	{
+		std::array<char, 4> head;
+		read_exact(src, head.data(), head.size());
+
+		auto const c = detect_codec(head);
+		if(!c) {
+			throw invalid();
+		}
+		this->codec_ = *c;
+	}
+
+	auto const end = src->pubseekoff(0, std::ios_base::end, std::ios_base::in);
+	auto const n   = static_cast<std::streamoff>(wrapped_size(this->codec_, TrailerPayloadSize));
+	if(end < 0 || end - this->base_ < n) [[unlikely]] {
+		throw invalid();
+	}
+
+	src->pubseekpos(end - n, std::ios_base::in);
+
+	auto const       trailer = unwrap(src, this->codec_, {'T', 'T'});
+	std::string_view t       = trailer;
+	if(!t.starts_with(TrailerMagic)) {
+		throw invalid();
+	}
+	t.remove_prefix(TrailerMagic.size());
+
+	auto const table_offset = get(t, 8);
+	auto const table_size   = get(t, 8);
+
+	src->pubseekpos(this->base_ + static_cast<std::streamoff>(table_offset), std::ios_base::in);
+
+	std::string table;
+	while(table.size() < table_size) {
+		table += unwrap(src, this->codec_, {'T', 'S'});
+	}
+
+	std::string_view r = table;
+
+	auto const frame_count = get(r, 8);
+	if(frame_count > r.size() / 16) [[unlikely]] {
+		throw invalid();
+	}
+	this->frames_.reserve(frame_count);
+	for(std::uint64_t i = 0; i < frame_count; ++i) {
+		auto const offset = get(r, 8);
+		this->frames_.push_back({.offset = offset, .uncompressed_offset = get(r, 8)});
+	}
+
+	auto const entry_count = get(r, 8);
+	if(entry_count > r.size() / 12) [[unlikely]] {
+		throw invalid();
+	}
+	this->entries_.reserve(entry_count);
+	for(std::uint64_t i = 0; i < entry_count; ++i) {
+		auto const offset = get(r, 8);
+		auto const size   = get(r, 4);
+		if(r.size() < size) [[unlikely]] {
+			throw invalid();
+		}
+
+		this->entries_.push_back({
+		    .offset      = offset,
+		    .path_offset = static_cast<std::uint32_t>(this->paths_.size()),
+		    .path_size   = static_cast<std::uint32_t>(size),
+		});
+		this->paths_.insert(this->paths_.end(), r.begin(), r.begin() + size);
+		r.remove_prefix(size);
+	}
+
+	// Keys refer to `paths_` so it must not grow after this.
+	this->lookup_.reserve(this->entries_.size());
+	for(std::size_t i = 0; i < this->entries_.size(); ++i) {
+		// Later entries overwrite earlier ones with the same path.
+		this->lookup_.insert_or_assign(this->path(this->entries_[i]), i);
+	}
+}
+
+seekable_archive::entry const* seekable_archive::find(std::string_view path) const {
+	auto const it = this->lookup_.find(path);
+	if(it == this->lookup_.end()) {
+		return nullptr;
+	}
+
+	return &this->entries_[it->second];
+}
+
+std::unique_ptr<istream> seekable_archive::open(entry const& e) const {
+	// Last frame starting at or before the entry.
+	auto it = std::upper_bound(this->frames_.begin(), this->frames_.end(), e.offset, [](std::uint64_t offset, compressed_frame const& f) {
+		return offset < f.uncompressed_offset;
+	});
+	if(it == this->frames_.begin()) [[unlikely]] {
+		throw std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), "malformed seek table");
+	}
+	--it;
+
+	this->src_->pubseekpos(this->base_ + static_cast<std::streamoff>(it->offset), std::ios_base::in);
+	return std::make_unique<seekable_istream>(this->src_, this->codec_, e.offset - it->uncompressed_offset);
+}
+
+std::unique_ptr<istream> seekable_archive::open(std::string_view path) const {
+	auto const* e = this->find(path);
+	if(e == nullptr) {
+		throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), std::string(path));
+	}
+
+	return this->open(*e);
+}
+
+}  // namespace ustar
+}  // namespace tar
@@ -0,0 +1,169 @@
+#include "tar/shared_archive.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <ios>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include "tar/detail/fd.hpp"
+#include "tar/fdbuf.hpp"
+#include "tar/index.hpp"
+#include "tar/ustar.hpp"
+
+#include <fcntl.h>
+
+namespace tar {
+namespace ustar {
+
+pread_streambuf::pread_streambuf(int fd, std::uint64_t begin, std::uint64_t end, std::size_t buffer_size)
+    : fd_(fd)
+    , begin_(begin)
+    , end_(end)
+    , next_(begin)
+    , in_(buffer_size) {
+	this->setg(this->in_.data(), this->in_.data(), this->in_.data());
+}
+
+pread_streambuf::pos_type pread_streambuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) {
+	if((which & std::ios_base::out) != 0) {
+		return pos_type(off_type(-1));
+	}
+
+	off_type base = 0;
+	switch(dir) {
+	case std::ios_base::cur:
+		base = static_cast<off_type>(this->offset_() - this->begin_);
+		break;
+	case std::ios_base::end:
+		base = static_cast<off_type>(this->end_ - this->begin_);
+		break;
+	default:
+		break;
+	}
+
+	return this->seekpos(pos_type(base + off), which);
+}
+
+pread_streambuf::pos_type pread_streambuf::seekpos(pos_type pos, std::ios_base::openmode which) {
+	auto const off = off_type(pos);
+	if((which & std::ios_base::out) != 0 || off < 0 || static_cast<std::uint64_t>(off) > this->end_ - this->begin_) {
+		return pos_type(off_type(-1));
+	}
+
+	auto const target = this->begin_ + static_cast<std::uint64_t>(off);
+	auto const first  = this->next_ - static_cast<std::uint64_t>(this->egptr() - this->eback());
+	if(first <= target && target <= this->next_) {
+		// Within the get area.
+		this->setg(this->eback(), this->eback() + (target - first), this->egptr());
+	} else {
+		this->setg(this->in_.data(), this->in_.data(), this->in_.data());
+		this->next_ = target;
+	}
+
+	return pos;
+}
+
+std::streamsize pread_streambuf::showmanyc() {
+	auto const n = this->end_ - this->offset_();
+	return n == 0 ? -1 : static_cast<std::streamsize>(n);
+}
+
+pread_streambuf::int_type pread_streambuf::underflow() {
+	if(this->gptr() < this->egptr()) {
+		return traits_type::to_int_type(*this->gptr());
+	}
+
+	auto const n = static_cast<std::size_t>(std::min<std::uint64_t>(this->in_.size(), this->end_ - this->next_));
+	if(n == 0) {
+		return traits_type::eof();
+	}
+
+	std::size_t l;
+	try {
+		l = detail::pread_full(this->fd_, this->in_.data(), n, this->next_);
+	} catch(std::system_error const&) {
+		return traits_type::eof();
+	}
+	if(l == 0) {
+		// File is shorter than the archive claims.
+		return traits_type::eof();
+	}
+
+	this->next_ += l;
+	this->setg(this->in_.data(), this->in_.data(), this->in_.data() + l);
+	return traits_type::to_int_type(*this->gptr());
+}
+
+std::streamsize pread_streambuf::xsgetn(char_type* s, std::streamsize count) {
+	auto const buffered = std::min<std::streamsize>(count, this->egptr() - this->gptr());
+	traits_type::copy(s, this->gptr(), static_cast<std::size_t>(buffered));
+	this->gbump(static_cast<int>(buffered));
+	if(buffered == count) {
+		return count;
+	}
+	if(static_cast<std::size_t>(count - buffered) < this->in_.size()) {
+		return buffered + std::streambuf::xsgetn(s + buffered, count - buffered);
+	}
+
+	// Large reads go directly to `s`.
+	auto const n = static_cast<std::size_t>(std::min<std::uint64_t>(static_cast<std::uint64_t>(count - buffered), this->end_ - this->next_));
+
+	std::size_t l;
+	try {
+		l = detail::pread_full(this->fd_, s + buffered, n, this->next_);
+	} catch(std::system_error const&) {
+		return buffered;
+	}
+
+	this->next_ += l;
+	this->setg(this->in_.data(), this->in_.data(), this->in_.data());
+	return buffered + static_cast<std::streamsize>(l);
+}
+
+pread_istream::pread_istream(int fd, std::uint64_t begin, std::uint64_t end)
+    : std::istream(nullptr)
+    , buf_(fd, begin, end) {
+	this->init(&this->buf_);
+}
+
+pread_istream::pread_istream(pread_istream&& other)
+    : std::istream(std::move(other))
+    , buf_(std::move(other.buf_)) {
+	this->set_rdbuf(&this->buf_);
+}
+
+shared_archive::shared_archive(std::filesystem::path const& p, bool verify_checksum)
+    : shared_archive(detail::unique_fd(::open(p.c_str(), O_RDONLY | O_CLOEXEC)), verify_checksum) { }
+
+shared_archive::shared_archive(int fd, bool verify_checksum)
+    : fd_(fd)
+    , buf_(std::make_unique<fdbuf>(fd, BlockSize))
+    , index_(this->buf_.get(), verify_checksum) { }
+
+shared_archive::shared_archive(detail::unique_fd fd, bool verify_checksum)
+    : owned_(std::move(fd))
+    , fd_(this->owned_.get())
+    , buf_(std::make_unique<fdbuf>(this->fd_, BlockSize))
+    , index_(this->buf_.get(), verify_checksum) { }
+
+pread_istream shared_archive::open(index::entry const& e) const {
+	return pread_istream(this->fd_, e.body_offset, e.body_offset + e.size);
+}
+
+pread_istream shared_archive::open(std::string_view path) const {
+	auto const* e = this->find(path);
+	if(e == nullptr) {
+		throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), std::string(path));
+	}
+
+	return this->open(*e);
+}
+
+}  // namespace ustar
+}  // namespace tar
@@ -0,0 +1,139 @@
+#include "tar/detail/sparse.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "tar/detail/fd.hpp"
+#include "tar/ustar.hpp"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace tar {
+namespace detail {
+
+std::vector<extent> data_extents(int fd, std::uintmax_t size) {
+	struct ::stat info;
+	if(::fstat(fd, &info) < 0) {
+		throw_errno();
+	}
+
+	// Allocated blocks cover the whole size so there is no hole to look for.
+	if(static_cast<std::uintmax_t>(info.st_blocks) * 512 >= size) [[likely]] {
+		return {extent{.offset = 0, .size = size}};
+	}
+
+	std::vector<extent> extents;
+	for(std::uintmax_t pos = 0; pos < size;) {
+		auto const data = ::lseek(fd, static_cast<::off_t>(pos), SEEK_DATA);
+		if(data < 0) {
+			if(errno == ENXIO) {
+				// No more data.
+				break;
+			}
+			if(errno == EINVAL || errno == EOPNOTSUPP) {
+				// Holes are not reported.
+				extents.assign({extent{.offset = 0, .size = size}});
+				break;
+			}
+
+			throw_errno();
+		}
+		if(static_cast<std::uintmax_t>(data) >= size) {
+			break;
+		}
+
+		auto const hole = ::lseek(fd, data, SEEK_HOLE);
+		if(hole < 0) {
+			throw_errno();
+		}
+
+		auto const end = std::min<std::uintmax_t>(hole, size);
+		extents.push_back({.offset = static_cast<std::uintmax_t>(data), .size = end - data});
+		pos = end;
+	}
+	if(extents.empty() || extents.back().offset + extents.back().size != size) {
+		extents.push_back({.offset = size, .size = 0});
+	}
+
+	if(::lseek(fd, 0, SEEK_SET) < 0) {
+		throw_errno();
+	}
+
+	return extents;
+}
+
+std::uintmax_t data_size(std::span<extent const> extents) {
+	std::uintmax_t total = 0;
+	for(auto const& e: extents) {
+		total += e.size;
+	}
+
+	return total;
+}
+
+std::string format_sparse_map(std::span<extent const> extents) {
+	std::string map = std::to_string(extents.size()) + '\n';
+	for(auto const& e: extents) {
+		map += std::to_string(e.offset) + '\n';
+		map += std::to_string(e.size) + '\n';
+	}
+
+	map.resize(ustar::padded_size(map.size()), '\0');
+	return map;
+}
+
+std::size_t parse_sparse_map(std::string_view data, std::vector<extent>& extents) {
+	auto const invalid = [] {
+		return std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), "malformed sparse map");
+	};
+
+	std::size_t pos  = 0;
+	auto const  next = [&](std::uintmax_t& v) {
+		auto const end = data.find('\n', pos);
+		if(end == std::string_view::npos) {
+			return false;
+		}
+
+		auto const [p, ec] = std::from_chars(data.data() + pos, data.data() + end, v);
+		if(ec != std::errc() || p != data.data() + end) [[unlikely]] {
+			throw invalid();
+		}
+
+		pos = end + 1;
+		return true;
+	};
+
+	std::uintmax_t n;
+	if(!next(n)) {
+		return 0;
+	}
+
+	extents.clear();
+	for(std::uintmax_t i = 0; i < n; ++i) {
+		extent e;
+		if(!next(e.offset) || !next(e.size)) {
+			return 0;
+		}
+		if(!extents.empty() && (e.offset < extents.back().offset + extents.back().size)) [[unlikely]] {
+			throw invalid();
+		}
+
+		extents.push_back(e);
+	}
+
+	auto const size = ustar::padded_size(pos);
+	return size <= data.size() ? size : 0;
+}
+
+}  // namespace detail
+}  // namespace tar
@@ -0,0 +1,261 @@
+#include "tar/tree.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "tar/detail/fd.hpp"
+#include "tar/detail/sparse.hpp"
+#include "tar/types.hpp"
+
+#include <fcntl.h>
+
+namespace tar {
+
+namespace {
+
+struct item {
+	std::filesystem::path path;  // Path on the file system.
+	std::filesystem::path name;  // Path in the archive.
+};
+
+bool is_directory(std::filesystem::directory_entry const& entry) {
+	return entry.symlink_status().type() == std::filesystem::file_type::directory;
+}
+
+// Depth-first walk with sorted children.
+// A directory is listed only when it is reached, so only the listings of the directories
+// on the way to the current item are held.
+class walker {
+   public:
+	walker(std::filesystem::path const& root, std::filesystem::path const& name)
+	    : root_(std::filesystem::directory_entry(root))
+	    , name_(name) { }
+
+	// Gives the next item in `it` and returns true, or returns false at the end.
+	// If a directory cannot be listed, it is given and the error is thrown; the walk goes on past it.
+	bool next(item& it) {
+		if(this->levels_.empty() && !this->root_.path().empty()) {
+			it = {.path = this->root_.path(), .name = this->name_};
+			auto const root = std::exchange(this->root_, {});
+			if(is_directory(root)) {
+				this->enter_(it);
+			}
+			return true;
+		}
+
+		while(!this->levels_.empty()) {
+			auto& level = this->levels_.back();
+			if(level.next == level.children.size()) {
+				this->levels_.pop_back();
+				continue;
+			}
+
+			auto const child = std::move(level.children[level.next++]);
+			it               = {.path = child.path(), .name = level.name / child.path().filename()};
+			if(is_directory(child)) {
+				this->enter_(it);
+			}
+			return true;
+		}
+
+		return false;
+	}
+
+   private:
+	struct level {
+		std::filesystem::path                         name;
+		std::vector<std::filesystem::directory_entry> children;
+		std::size_t                                   next = 0;
+	};
+
+	void enter_(item const& dir) {
+		std::vector<std::filesystem::directory_entry> children(std::filesystem::directory_iterator(dir.path), {});
+		std::sort(children.begin(), children.end(), [](auto const& lhs, auto const& rhs) {
+			return lhs.path().filename() < rhs.path().filename();
+		});
+
+		this->levels_.push_back({.name = dir.name, .children = std::move(children)});
+	}
+
+	std::filesystem::directory_entry root_;  // Empty once given.
+	std::filesystem::path            name_;
+
+	std::vector<level> levels_;
+};
+
+// Entry prepared to be written.
+struct slot {
+	item it;
+
+	header            h;
+	file_id           id;
+	detail::unique_fd fd;
+	std::vector<char> head;  // Beginning of the body.
+
+	std::vector<extent> extents;  // Of data if the file has holes.
+
+	std::exception_ptr error;
+
+	bool ready = false;
+};
+
+void prepare(item const& it, std::size_t prefetch_size, name_cache& names, slot& s) {
+	try {
+		s.h = header_of(it.path, it.name, names, s.id);
+		if(s.h.size == 0) {
+			return;
+		}
+
+		s.fd = detail::unique_fd(::open(it.path.c_str(), O_RDONLY | O_CLOEXEC));
+		::posix_fadvise(s.fd.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+		if(auto extents = detail::data_extents(s.fd.get(), s.h.size); detail::data_size(extents) < s.h.size) {
+			// Read by extents when written.
+			s.extents = std::move(extents);
+			return;
+		}
+
+		s.head.resize(std::min<std::uintmax_t>(s.h.size, prefetch_size));
+		s.head.resize(detail::read_full(s.fd.get(), s.head.data(), s.head.size()));
+	} catch(...) {
+		s.error = std::current_exception();
+	}
+}
+
+void write(ostream& o, item const& it, slot& s) {
+	if(s.error) {
+		std::rethrow_exception(s.error);
+	}
+	if(o.next_link(s.h, s.id)) {
+		// Links are resolved here rather than when prepared, as entries are prepared out of order.
+		return;
+	}
+
+	if(!s.extents.empty() && o.next_sparse(s.h, s.extents)) {
+		if(o.write_from(s.fd.get(), s.extents) != detail::data_size(s.extents)) [[unlikely]] {
+			throw std::system_error(std::make_error_code(std::errc::io_error), "file shrank while being read: " + it.path.string());
+		}
+		return;
+	}
+
+	o.next(s.h, s.h.size);
+	o.write(s.head.data(), static_cast<std::streamsize>(s.head.size()));
+	if(s.head.size() == s.h.size) {
+		return;
+	}
+
+	// Copies no more than the size written in the header even if the file grows meanwhile.
+	auto const rest = s.h.size - s.head.size();
+	if(o.write_from(s.fd.get(), rest) != rest) [[unlikely]] {
+		throw std::system_error(std::make_error_code(std::errc::io_error), "file shrank while being read: " + it.path.string());
+	}
+}
+
+}  // namespace
+
+void write_tree(ostream& o, std::filesystem::path const& root, std::filesystem::path const& as, write_tree_options const& options) {
+	walker w(root, as.empty() ? root : as);
+
+	// Held here in case the stream's cache is replaced meanwhile.
+	auto const names = o.names();
+
+	std::vector<slot> slots(std::max<std::size_t>(options.read_ahead, 1));
+
+	std::mutex              mutex;
+	std::condition_variable cv;
+
+	std::size_t taken   = 0;
+	std::size_t written = 0;
+	bool        walked  = false;  // Whether all items are taken.
+	bool        stop    = false;
+
+	auto const work = [&] {
+		while(true) {
+			slot* s;
+			{
+				std::unique_lock lock(mutex);
+				cv.wait(lock, [&] { return stop || walked || (taken < written + slots.size()); });
+				if(stop || walked) {
+					return;
+				}
+
+				// Walked under the lock so items are taken in order; a directory is listed once reached.
+				s = &slots[taken % slots.size()];
+				try {
+					if(!w.next(s->it)) {
+						walked = true;
+						lock.unlock();
+						cv.notify_all();
+						return;
+					}
+				} catch(...) {
+					s->error = std::current_exception();
+				}
+				++taken;
+			}
+
+			if(!s->error) {
+				prepare(s->it, options.prefetch_size, *names, *s);
+			}
+			{
+				std::scoped_lock lock(mutex);
+				s->ready = true;
+			}
+			cv.notify_all();
+		}
+	};
+
+	auto n = options.threads != 0 ? options.threads : std::thread::hardware_concurrency();
+	n      = std::max<std::size_t>(n, 1);
+
+	std::vector<std::jthread> workers;
+	workers.reserve(n);
+	for(std::size_t k = 0; k < n; ++k) {
+		workers.emplace_back(work);
+	}
+
+	auto const finish = [&] {
+		{
+			std::scoped_lock lock(mutex);
+			stop = true;
+		}
+		cv.notify_all();
+		workers.clear();
+	};
+
+	try {
+		for(std::size_t i = 0;; ++i) {
+			auto& s = slots[i % slots.size()];
+			{
+				std::unique_lock lock(mutex);
+				cv.wait(lock, [&] { return s.ready || (walked && i == taken); });
+				if(!s.ready) {
+					break;
+				}
+			}
+
+			write(o, s.it, s);
+			s = slot();
+			{
+				std::scoped_lock lock(mutex);
+				++written;
+			}
+			cv.notify_all();
+		}
+	} catch(...) {
+		finish();
+		throw;
+	}
+
+	finish();
+}
+
+}  // namespace tar
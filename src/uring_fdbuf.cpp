@@ -0,0 +1,650 @@
+#include "tar/uring_fdbuf.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <ios>
+#include <memory>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "tar/detail/fd.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef TAR_HAS_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+namespace tar {
+
+class uring_fdbuf::ring {
+   public:
+	virtual ~ring() = default;
+
+	virtual bool async() const = 0;
+
+	// Queues a read into `buf`, or a write of it, at `offset` of `fd`.
+	// `id` is less than the depth and is given back by `wait` once the request completes.
+	virtual void submit(bool write, int fd, char* buf, std::size_t size, std::uint64_t offset, std::size_t id) = 0;
+
+	// Waits for a request to complete and returns its ID and result, which is the number of bytes or negated `errno`.
+	virtual std::pair<std::size_t, std::int64_t> wait() = 0;
+};
+
+namespace {
+
+// Completes each request as it is submitted.
+class sync_ring: public uring_fdbuf::ring {
+   public:
+	bool async() const override {
+		return false;
+	}
+
+	void submit(bool write, int fd, char* buf, std::size_t size, std::uint64_t offset, std::size_t id) override {
+		::ssize_t l;
+		do {
+			l = write ? ::pwrite(fd, buf, size, static_cast<::off_t>(offset)) : ::pread(fd, buf, size, static_cast<::off_t>(offset));
+		} while(l < 0 && errno == EINTR);
+
+		this->done_.emplace_back(id, l < 0 ? -std::int64_t(errno) : std::int64_t(l));
+	}
+
+	std::pair<std::size_t, std::int64_t> wait() override {
+		auto const v = this->done_.front();
+		this->done_.pop_front();
+		return v;
+	}
+
+   private:
+	std::deque<std::pair<std::size_t, std::int64_t>> done_;
+};
+
+#ifdef TAR_HAS_IO_URING
+
+// Memory shared with the kernel.
+class mapping {
+   public:
+	mapping(int fd, std::size_t size, ::off_t offset)
+	    : size_(size) {
+		this->data_ = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+		if(this->data_ == MAP_FAILED) {
+			detail::throw_errno();
+		}
+	}
+
+	mapping(mapping const& other) = delete;
+
+	~mapping() {
+		::munmap(this->data_, this->size_);
+	}
+
+	mapping& operator=(mapping const& other) = delete;
+
+	template<typename T>
+	T* at(std::size_t offset) const {
+		return reinterpret_cast<T*>(static_cast<char*>(this->data_) + offset);
+	}
+
+   private:
+	void*       data_;
+	std::size_t size_;
+};
+
+// Talks to the kernel by system calls directly so liburing is not needed.
+class io_ring: public uring_fdbuf::ring {
+   public:
+	// Throws `std::system_error` if io_uring is not available.
+	io_ring(unsigned entries)
+	    : fd_(setup(entries, this->params_))
+	    , sq_(this->fd_.get(), sq_size(this->params_), IORING_OFF_SQ_RING)
+	    , cq_(this->fd_.get(), cq_size(this->params_), IORING_OFF_CQ_RING)
+	    , sqes_(this->fd_.get(), this->params_.sq_entries * sizeof(::io_uring_sqe), IORING_OFF_SQES)
+	    , iovecs_(entries) {
+		auto const& p = this->params_;
+
+		this->sq_tail_  = this->sq_.at<unsigned>(p.sq_off.tail);
+		this->sq_mask_  = *this->sq_.at<unsigned>(p.sq_off.ring_mask);
+		this->sq_array_ = this->sq_.at<unsigned>(p.sq_off.array);
+
+		this->cq_head_ = this->cq_.at<unsigned>(p.cq_off.head);
+		this->cq_tail_ = this->cq_.at<unsigned>(p.cq_off.tail);
+		this->cq_mask_ = *this->cq_.at<unsigned>(p.cq_off.ring_mask);
+		this->cqes_    = this->cq_.at<::io_uring_cqe>(p.cq_off.cqes);
+	}
+
+	bool async() const override {
+		return true;
+	}
+
+	void submit(bool write, int fd, char* buf, std::size_t size, std::uint64_t offset, std::size_t id) override {
+		auto const tail = *this->sq_tail_;
+		auto const i    = tail & this->sq_mask_;
+
+		// Kept until the request completes, as the kernel may read it after the submission.
+		this->iovecs_[id] = {.iov_base = buf, .iov_len = size};
+
+		auto& sqe     = this->sqes_.at<::io_uring_sqe>(0)[i];
+		sqe           = {};
+		sqe.opcode    = write ? IORING_OP_WRITEV : IORING_OP_READV;
+		sqe.fd        = fd;
+		sqe.addr      = reinterpret_cast<std::uint64_t>(&this->iovecs_[id]);
+		sqe.len       = 1;
+		sqe.off       = offset;
+		sqe.user_data = id;
+
+		this->sq_array_[i] = i;
+		std::atomic_ref<unsigned>(*this->sq_tail_).store(tail + 1, std::memory_order_release);
+
+		while(enter(this->fd_.get(), 1, 0, 0) < 0) {
+			if(errno != EINTR) {
+				detail::throw_errno();
+			}
+		}
+	}
+
+	std::pair<std::size_t, std::int64_t> wait() override {
+		while(true) {
+			auto const head = *this->cq_head_;
+			if(head != std::atomic_ref<unsigned>(*this->cq_tail_).load(std::memory_order_acquire)) {
+				auto const& cqe = this->cqes_[head & this->cq_mask_];
+
+				std::pair<std::size_t, std::int64_t> const v(cqe.user_data, cqe.res);
+				std::atomic_ref<unsigned>(*this->cq_head_).store(head + 1, std::memory_order_release);
+				return v;
+			}
+
+			if(enter(this->fd_.get(), 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+				detail::throw_errno();
+			}
+		}
+	}
+
+   private:
+	static int setup(unsigned entries, ::io_uring_params& p) {
+		return static_cast<int>(::syscall(__NR_io_uring_setup, entries, &p));
+	}
+
+	static int enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+		return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+	}
+
+	static std::size_t sq_size(::io_uring_params const& p) {
+		return p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	}
+
+	static std::size_t cq_size(::io_uring_params const& p) {
+		return p.cq_off.cqes + p.cq_entries * sizeof(::io_uring_cqe);
+	}
+
+	::io_uring_params params_ = {};
+
+	detail::unique_fd fd_;
+
+	mapping sq_;
+	mapping cq_;
+	mapping sqes_;
+
+	unsigned* sq_tail_;
+	unsigned  sq_mask_;
+	unsigned* sq_array_;
+
+	unsigned*       cq_head_;
+	unsigned*       cq_tail_;
+	unsigned        cq_mask_;
+	::io_uring_cqe* cqes_;
+
+	std::vector<::iovec> iovecs_;  // Of each request in flight, by its ID.
+};
+
+#endif
+
+std::unique_ptr<uring_fdbuf::ring> make_ring(uring_options const& options) {
+#ifdef TAR_HAS_IO_URING
+	if(options.use_io_uring) {
+		try {
+			return std::make_unique<io_ring>(static_cast<unsigned>(options.depth));
+		} catch(std::system_error const&) {
+			// Not supported by the kernel or not permitted, e.g. by seccomp.
+		}
+	}
+#endif
+
+	return std::make_unique<sync_ring>();
+}
+
+}  // namespace
+
+uring_fdbuf::uring_fdbuf(int fd, uring_options const& options)
+    : fd_(fd)
+    , blocks_(std::max<std::size_t>(options.depth, 1))
+    , ring_(make_ring({.depth = blocks_.size(), .use_io_uring = options.use_io_uring})) {
+	auto const pos = ::lseek(fd, 0, SEEK_CUR);
+	if(pos < 0) {
+		detail::throw_errno();
+	}
+
+	this->base_      = static_cast<std::uint64_t>(pos);
+	this->read_next_ = this->base_;
+
+	for(auto& b: this->blocks_) {
+		b.data.resize(std::max<std::size_t>(options.block_size, 4096));
+	}
+}
+
+uring_fdbuf::~uring_fdbuf() {
+	this->sync();
+}
+
+bool uring_fdbuf::uses_io_uring() const {
+	return this->ring_->async();
+}
+
+std::uintmax_t uring_fdbuf::transfer_from(int in, std::uintmax_t n) {
+	if(!this->drain_()) [[unlikely]] {
+		throw std::system_error(std::make_error_code(std::errc::io_error), "failed to write");
+	}
+
+	auto const in_begin = ::lseek(in, 0, SEEK_CUR);
+	if(in_begin < 0) {
+		return 0;
+	}
+
+	std::uint64_t issued = 0;  // Requested from `in`.
+	std::uint64_t done   = 0;  // Read from `in` and queued to be written.
+	std::uint64_t limit  = n;
+	int           error  = 0;
+
+	// `reads_` holds blocks read from `in` in the order of their offsets, each of which is written once it and ones before it are read.
+	while(true) {
+		for(std::size_t i = 0; i < this->blocks_.size() && issued < limit; ++i) {
+			if(!this->free_(i)) {
+				continue;
+			}
+
+			auto& b   = this->blocks_[i];
+			b.offset  = static_cast<std::uint64_t>(in_begin) + issued;
+			b.size    = static_cast<std::size_t>(std::min<std::uint64_t>(b.data.size(), limit - issued));
+			b.busy    = true;
+			b.writing = false;
+			this->ring_->submit(false, in, b.data.data(), b.size, b.offset, i);
+			++this->inflight_;
+			this->reads_.push_back(i);
+
+			issued += b.size;
+		}
+		if(this->inflight_ == 0) {
+			break;
+		}
+
+		this->complete_();
+		while(!this->reads_.empty() && !this->blocks_[this->reads_.front()].busy) {
+			auto& b = this->blocks_[this->reads_.front()];
+			this->reads_.pop_front();
+
+			if(b.result < 0) {
+				error = static_cast<int>(-b.result);
+				limit = done;
+			}
+			if(done >= limit || b.offset != static_cast<std::uint64_t>(in_begin) + done) {
+				// Beyond the end of `in`.
+				continue;
+			}
+
+			auto const l = static_cast<std::size_t>(std::min<std::uint64_t>(b.result, limit - done));
+			if(l < b.size) {
+				limit = done + l;
+			}
+			if(l == 0) {
+				continue;
+			}
+
+			b.offset  = this->base_ + done;
+			b.size    = l;
+			b.busy    = true;
+			b.writing = true;
+			this->ring_->submit(true, this->fd_, b.data.data(), b.size, b.offset, static_cast<std::size_t>(&b - this->blocks_.data()));
+			++this->inflight_;
+
+			done += l;
+		}
+	}
+
+	this->base_ += done;
+	if(error != 0) [[unlikely]] {
+		throw std::system_error(error, std::generic_category());
+	}
+	if(std::exchange(this->failed_, false)) [[unlikely]] {
+		throw std::system_error(std::make_error_code(std::errc::io_error), "failed to write");
+	}
+	if(::lseek(in, in_begin + static_cast<::off_t>(done), SEEK_SET) < 0) {
+		detail::throw_errno();
+	}
+
+	return done;
+}
+
+uring_fdbuf::pos_type uring_fdbuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode) {
+	if(dir == std::ios_base::cur && off == 0) {
+		// Tells the position without touching the buffers.
+		return pos_type(off_type(this->position_()));
+	}
+
+	try {
+		off_type target = off;
+		switch(dir) {
+		case std::ios_base::cur:
+			target += static_cast<off_type>(this->position_());
+			break;
+
+		case std::ios_base::end: {
+			if(!this->drain_()) [[unlikely]] {
+				return pos_type(off_type(-1));
+			}
+
+			struct ::stat info;
+			if(::fstat(this->fd_, &info) < 0) {
+				return pos_type(off_type(-1));
+			}
+			target += info.st_size;
+			break;
+		}
+
+		default:
+			break;
+		}
+		if(target < 0) {
+			return pos_type(off_type(-1));
+		}
+
+		auto const offset = static_cast<std::uint64_t>(target);
+		if(this->mode_ == mode::read && this->seek_read_(offset)) {
+			return pos_type(target);
+		}
+		if(!this->drain_()) [[unlikely]] {
+			return pos_type(off_type(-1));
+		}
+
+		this->base_ = offset;
+		return pos_type(target);
+	} catch(std::system_error const&) {
+		return pos_type(off_type(-1));
+	}
+}
+
+uring_fdbuf::pos_type uring_fdbuf::seekpos(pos_type pos, std::ios_base::openmode which) {
+	return this->seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+int uring_fdbuf::sync() {
+	try {
+		auto const ok = this->drain_();
+		if(::lseek(this->fd_, static_cast<::off_t>(this->base_), SEEK_SET) < 0) {
+			return -1;
+		}
+
+		return ok ? 0 : -1;
+	} catch(std::system_error const&) {
+		return -1;
+	}
+}
+
+uring_fdbuf::int_type uring_fdbuf::underflow() {
+	if(this->gptr() < this->egptr()) {
+		return traits_type::to_int_type(*this->gptr());
+	}
+
+	try {
+		if(this->mode_ != mode::read) {
+			auto const ok = this->drain_();
+
+			this->mode_      = mode::read;
+			this->read_next_ = this->base_;
+			if(!ok) [[unlikely]] {
+				return traits_type::eof();
+			}
+		}
+
+		auto const pos = this->position_();
+		if(this->has_area_) {
+			if(this->blocks_[this->current_].result == 0) {
+				// At the end of the file.
+				return traits_type::eof();
+			}
+
+			this->has_area_ = false;
+			this->setg(nullptr, nullptr, nullptr);
+		}
+		this->base_ = pos;
+
+		while(true) {
+			this->read_ahead_();
+
+			auto const i = this->reads_.front();
+			while(this->blocks_[i].busy) {
+				this->complete_();
+			}
+
+			auto& b = this->blocks_[i];
+			if(b.offset != pos || b.result < 0) {
+				// Reads issued past a short read are not contiguous with it.
+				auto const failed = b.result < 0;
+				this->drain_();
+
+				this->mode_      = mode::read;
+				this->read_next_ = pos;
+				if(failed) [[unlikely]] {
+					return traits_type::eof();
+				}
+				continue;
+			}
+
+			this->reads_.pop_front();
+			this->current_  = i;
+			this->has_area_ = true;
+			this->setg(b.data.data(), b.data.data(), b.data.data() + b.result);
+			if(b.result == 0) {
+				return traits_type::eof();
+			}
+
+			return traits_type::to_int_type(*this->gptr());
+		}
+	} catch(std::system_error const&) {
+		return traits_type::eof();
+	}
+}
+
+uring_fdbuf::int_type uring_fdbuf::overflow(int_type ch) {
+	try {
+		if(this->mode_ != mode::write) {
+			if(!this->drain_()) [[unlikely]] {
+				return traits_type::eof();
+			}
+			this->mode_ = mode::write;
+		} else {
+			this->write_out_();
+		}
+		if(this->failed_) [[unlikely]] {
+			return traits_type::eof();
+		}
+
+		auto i = this->blocks_.size();
+		while(true) {
+			for(i = 0; i < this->blocks_.size() && !this->free_(i); ++i) { }
+			if(i < this->blocks_.size()) {
+				break;
+			}
+			this->complete_();
+		}
+
+		auto& b         = this->blocks_[i];
+		this->current_  = i;
+		this->has_area_ = true;
+		this->setp(b.data.data(), b.data.data() + b.data.size());
+	} catch(std::system_error const&) {
+		return traits_type::eof();
+	}
+	if(traits_type::eq_int_type(ch, traits_type::eof())) {
+		return traits_type::not_eof(ch);
+	}
+
+	*this->pptr() = traits_type::to_char_type(ch);
+	this->pbump(1);
+	return ch;
+}
+
+std::uint64_t uring_fdbuf::position_() const {
+	if(!this->has_area_) {
+		return this->base_;
+	}
+	if(this->mode_ == mode::read) {
+		return this->base_ + static_cast<std::uint64_t>(this->gptr() - this->eback());
+	}
+
+	return this->base_ + static_cast<std::uint64_t>(this->pptr() - this->pbase());
+}
+
+bool uring_fdbuf::free_(std::size_t i) const {
+	if(this->blocks_[i].busy || (this->has_area_ && this->current_ == i)) {
+		return false;
+	}
+
+	return std::find(this->reads_.begin(), this->reads_.end(), i) == this->reads_.end();
+}
+
+void uring_fdbuf::complete_() {
+	auto const [i, result] = this->ring_->wait();
+	--this->inflight_;
+
+	auto& b  = this->blocks_[i];
+	b.busy   = false;
+	b.result = result;
+	if(!b.writing) {
+		return;
+	}
+	if(result < 0) [[unlikely]] {
+		this->failed_ = true;
+		return;
+	}
+
+	if(auto const l = static_cast<std::size_t>(result); l < b.size) {
+		// Rest of a short write.
+		try {
+			detail::pwrite_full(this->fd_, b.data.data() + l, b.size - l, b.offset + l);
+		} catch(std::system_error const&) {
+			this->failed_ = true;
+		}
+	}
+}
+
+bool uring_fdbuf::drain_() {
+	auto const pos = this->position_();
+	this->write_out_();
+	while(this->inflight_ > 0) {
+		this->complete_();
+	}
+
+	this->reads_.clear();
+	this->has_area_ = false;
+	this->setg(nullptr, nullptr, nullptr);
+	this->setp(nullptr, nullptr);
+
+	this->mode_ = mode::none;
+	this->base_ = pos;
+	return !std::exchange(this->failed_, false);
+}
+
+void uring_fdbuf::read_ahead_() {
+	for(std::size_t i = 0; i < this->blocks_.size(); ++i) {
+		if(!this->free_(i)) {
+			continue;
+		}
+
+		auto& b   = this->blocks_[i];
+		b.offset  = this->read_next_;
+		b.size    = b.data.size();
+		b.busy    = true;
+		b.writing = false;
+		this->ring_->submit(false, this->fd_, b.data.data(), b.size, b.offset, i);
+		++this->inflight_;
+		this->reads_.push_back(i);
+
+		this->read_next_ += b.size;
+	}
+}
+
+bool uring_fdbuf::seek_read_(std::uint64_t offset) {
+	if(this->has_area_) {
+		if(offset >= this->base_ && offset <= this->base_ + static_cast<std::uint64_t>(this->egptr() - this->eback())) {
+			this->setg(this->eback(), this->eback() + (offset - this->base_), this->egptr());
+			return true;
+		}
+	}
+
+	auto const it = std::find_if(this->reads_.begin(), this->reads_.end(), [&](std::size_t i) {
+		auto const& b = this->blocks_[i];
+		return offset >= b.offset && offset < b.offset + b.size;
+	});
+	if(it == this->reads_.end()) {
+		return false;
+	}
+
+	// Blocks before the one holding `offset` are skipped.
+	auto const i = *it;
+	this->reads_.erase(this->reads_.begin(), it);
+	this->has_area_ = false;
+	this->setg(nullptr, nullptr, nullptr);
+	this->base_ = offset;
+
+	while(this->blocks_[i].busy) {
+		this->complete_();
+	}
+
+	auto& b = this->blocks_[i];
+	if(b.result < 0 || offset > b.offset + static_cast<std::uint64_t>(b.result)) {
+		return false;
+	}
+
+	this->reads_.pop_front();
+	this->current_  = i;
+	this->has_area_ = true;
+	this->base_     = b.offset;
+	this->setg(b.data.data(), b.data.data() + (offset - b.offset), b.data.data() + b.result);
+
+	this->read_ahead_();
+	return true;
+}
+
+void uring_fdbuf::write_out_() {
+	if(this->mode_ != mode::write || !this->has_area_) {
+		return;
+	}
+
+	auto const n = static_cast<std::size_t>(this->pptr() - this->pbase());
+
+	this->has_area_ = false;
+	this->setp(nullptr, nullptr);
+	if(n == 0) {
+		return;
+	}
+
+	auto& b   = this->blocks_[this->current_];
+	b.offset  = this->base_;
+	b.size    = n;
+	b.busy    = true;
+	b.writing = true;
+	this->ring_->submit(true, this->fd_, b.data.data(), b.size, b.offset, this->current_);
+	++this->inflight_;
+
+	this->base_ += n;
+}
+
+}  // namespace tar
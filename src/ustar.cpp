@@ -3,15 +3,23 @@
 #include <algorithm>
 #include <array>
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
 #include <ios>
 #include <iterator>
-#include <numeric>
+#include <span>
+#include <string>
 #include <system_error>
+#include <tuple>
 #include <utility>
 
+#include "tar/detail/checksum.hpp"
 #include "tar/detail/marshal.hpp"
+#include "tar/detail/pax.hpp"
+#include "tar/detail/sparse.hpp"
+#include "tar/fdbuf.hpp"
+#include "tar/uring_fdbuf.hpp"
 
 namespace tar {
 namespace ustar {
@@ -79,42 +87,188 @@ header::operator tar::header() {
 	return h;
 }
 
+static_assert(BlockSize == detail::SumBlockSize);
+
+std::uint32_t header::checksum() const {
+	auto sum = detail::sum_block(this);
+	for(auto const c: this->chksum) {
+		sum -= static_cast<std::uint8_t>(c);
+	}
+
+	return sum + ' ' * this->chksum.size();
+}
+
+bool header::verify() const {
+	auto const expected = detail::from_octal(this->chksum.data(), this->chksum.size());
+
+	auto const sum = this->checksum();
+	if(sum == expected) [[likely]] {
+		return true;
+	}
+
+	// Each byte over 127 is 256 less when summed as signed.
+	auto const* const b = reinterpret_cast<std::uint8_t const*>(this);
+
+	std::int64_t signed_sum = sum;
+	for(std::size_t i = 0; i < sizeof(header); ++i) {
+		if(b[i] > 127 && (i < offsetof(header, chksum) || i >= offsetof(header, typeflag))) {
+			signed_sum -= 256;
+		}
+	}
+
+	return static_cast<std::uintmax_t>(signed_sum) == expected;
+}
+
+namespace {
+
+void update_checksum(header& h) {
+	detail::marshal(h.checksum(), h.chksum, 6);
+	h.chksum[6] = '\0';
+	h.chksum[7] = ' ';
+}
+
+}  // namespace
+
 istream::istream(std::streambuf* buf)
     : tar::istream()
     , buf_(buf) {
 	this->init(&this->buf_);
-	this->header_next_ = this->tellg();
+	this->header_next_ = buf->pubseekoff(0, std::ios_base::cur, std::ios_base::in);
+	this->seekable_    = this->header_next_ != pos_type(off_type(-1));
+	if(!this->seekable_) {
+		// Positions are counted from here.
+		this->header_next_ = 0;
+	}
 }
 
 istream::~istream() { }
 
 istream& istream::next(header& h) {
-	auto const body_begin = this->header_next_ + static_cast<off_type>(sizeof(header));
-	this->buf_.reset(this->header_next_, body_begin);
-	this->clear();
-	this->read(reinterpret_cast<char*>(&h), sizeof(h));
-	if(!this->operator bool()) [[unlikely]] {
-		return *this;
+	std::string records;  // Of a PAX extended header, applied to the next header.
+	this->header_cur_ = this->header_next_;
+	this->path_.clear();
+	this->sparse_    = false;
+	this->real_size_ = 0;
+	while(true) {
+		auto const body_begin = this->header_next_ + static_cast<off_type>(sizeof(header));
+		this->reach_(this->header_next_, body_begin);
+		this->clear();
+		this->read(reinterpret_cast<char*>(&h), sizeof(h));
+		if(!this->operator bool()) [[unlikely]] {
+			return *this;
+		}
+		if(h.name[0] == '\0') [[unlikely]] {
+			// End of archive.
+			this->setstate(std::ios_base::eofbit | std::ios_base::failbit);
+			return *this;
+		}
+		if(this->verify_ && !h.verify()) [[unlikely]] {
+			this->setstate(std::ios_base::badbit);
+			return *this;
+		}
+		if(!records.empty()) {
+			if(!detail::apply_pax(records, h)) [[unlikely]] {
+				this->setstate(std::ios_base::badbit);
+				return *this;
+			}
+			update_checksum(h);
+
+			auto pax         = detail::read_pax_entry(records);
+			this->path_      = std::move(pax.path);
+			this->sparse_    = pax.sparse;
+			this->real_size_ = pax.real_size;
+		}
+
+		std::uintmax_t size;
+		if(!detail::unmarshal_size(h.size, size) || !fits_stream(static_cast<std::uintmax_t>(off_type(body_begin)), size)) [[unlikely]] {
+			this->setstate(std::ios_base::badbit);
+			return *this;
+		}
+
+		this->reach_(body_begin, body_begin + static_cast<off_type>(size));
+		this->header_next_ = body_begin + static_cast<off_type>(padded_size(size));
+		if(h.typeflag != PaxExtended && h.typeflag != PaxGlobal) [[likely]] {
+			if(!this->sparse_) {
+				this->real_size_ = size;
+			}
+			return *this;
+		}
+		if(size > detail::MaxPaxSize) [[unlikely]] {
+			this->setstate(std::ios_base::badbit);
+			return *this;
+		}
+
+		records.resize(size);
+		this->read(records.data(), static_cast<std::streamsize>(size));
+		if(!this->operator bool()) [[unlikely]] {
+			return *this;
+		}
+		if(h.typeflag == PaxGlobal) {
+			// Not supported; global records are ignored.
+			records.clear();
+		}
 	}
+}
 
-	std::size_t size;
-	detail::unmarshal(h.size, size);
+void istream::reach_(pos_type begin, pos_type end) {
+	if(this->seekable_) [[likely]] {
+		this->buf_.reset(begin, end);
+	} else {
+		this->buf_.forward(begin, end);
+	}
+}
 
-	this->buf_.reset(body_begin, body_begin + static_cast<off_type>(size));
-	this->header_next_ = body_begin + static_cast<off_type>((size / BlockSize + 1) * BlockSize);
+ostream::ostream(std::streambuf* buf)
+    : tar::ostream(nullptr)
+    , buf_(buf) {
+	this->init(&this->buf_);
+}
 
-	return *this;
+namespace {
+
+// Positions `buf` to write at the end-of-archive marker of the archive in it,
+// or at where the marker would be if the archive ends without one.
+std::streambuf* seek_to_end(std::streambuf* buf) {
+	std::streambuf::pos_type end;
+	{
+		istream i(buf);
+		if(!i.seekable()) [[unlikely]] {
+			throw std::system_error(std::make_error_code(std::errc::invalid_seek));
+		}
+
+		header h;
+		while(i.next(h)) { }
+		if(i.bad()) [[unlikely]] {
+			throw std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), "malformed archive");
+		}
+
+		end = i.header_offset();
+	}
+	if(buf->pubseekoff(0, std::ios_base::end, std::ios_base::in) < end) [[unlikely]] {
+		throw std::system_error(std::make_error_code(std::errc::io_error), "archive is truncated");
+	}
+
+	buf->pubseekpos(end, std::ios_base::out);
+	return buf;
 }
 
+}  // namespace
+
+ostream::ostream(std::streambuf* buf, append_t)
+    : ostream(seek_to_end(buf)) { }
+
 ostream::~ostream() {
-	this->seal_();
+	try {
+		this->seal_();
+	} catch(...) {
+		this->setstate(std::ios_base::badbit);
+	}
 	std::fill_n(std::ostream_iterator<char>(*this), BlockSize * 2, 0);
 }
 
 ostream& ostream::next(header const& h) {
-	if(this->header_pos_ != -1) [[likely]] {
-		this->seal_();
-	}
+	this->seal_();
+	this->begin_(h, false);
 
 	this->header_cur_ = h;
 	this->header_pos_ = this->tellp();  // Remember where the header is to update some fields (size, chksum) later.
@@ -125,30 +279,135 @@ ostream& ostream::next(header const& h) {
 	return *this;
 }
 
+ostream& ostream::next(header const& h, std::uintmax_t size) {
+	this->seal_();
+	this->begin_(h, true);
+	this->put_(h, size);
+
+	return *this;
+}
+
+void ostream::begin_(header const& h, bool size_known) {
+	header_view const v(h);
+	if(v.prefix().empty()) {
+		this->begin_entry_(v.name(), size_known);
+		return;
+	}
+
+	this->begin_entry_(std::string(v.prefix()) + '/' + std::string(v.name()), size_known);
+}
+
+void ostream::put_(header const& h, std::uintmax_t size) {
+	this->seal_();
+
+	this->header_cur_ = h;
+	detail::marshal(size, this->header_cur_.size);
+	update_checksum(this->header_cur_);
+
+	this->write(reinterpret_cast<char const*>(&this->header_cur_), sizeof(header));
+
+	this->body_begin_ = this->buf_.count();
+	this->body_size_  = size;
+}
+
+namespace {
+
+// Path of an entry auxiliary to the one of `p`, e.g. "foo/PaxHeaders/bar" for "foo/bar" as GNU tar names them.
+// Falls back to `p` if it does not fit in the name field.
+std::filesystem::path aux_path_of(std::filesystem::path const& p, char const* dir) {
+	auto v = p.parent_path() / dir / p.filename();
+	if(v.native().size() >= std::tuple_size_v<decltype(header::name)>) {
+		return p;
+	}
+
+	return v;
+}
+
+}  // namespace
+
+bool ostream::next_sparse(tar::header const& h, std::span<extent const> extents) {
+	auto const records = detail::pax_record("GNU.sparse.major", "1")
+	                     + detail::pax_record("GNU.sparse.minor", "0")
+	                     + detail::pax_record("GNU.sparse.name", h.path.string())
+	                     + detail::pax_record("GNU.sparse.realsize", std::to_string(h.size));
+
+	auto const map = detail::format_sparse_map(extents);
+
+	auto data = h;
+	data.path = aux_path_of(h.path, "GNUSparseFile.0");
+	data.size = map.size() + detail::data_size(extents);
+
+	// Made before anything is written so an entry is not left half written if the path is too long.
+	auto const data_header = header::from(data);
+	auto const pax_header  = header::from(tar::header{
+	    .path            = aux_path_of(h.path, "PaxHeaders"),
+	    .permissions     = h.permissions,
+	    .size            = records.size(),
+	    .last_write_time = h.last_write_time,
+	    .type            = PaxExtended,
+	});
+
+	// Both headers make a single entry of the real path.
+	this->seal_();
+	this->begin_entry_(h.path.string(), true);
+
+	this->put_(pax_header, records.size());
+	this->write(records.data(), static_cast<std::streamsize>(records.size()));
+
+	this->put_(data_header, data.size);
+	this->write(map.data(), static_cast<std::streamsize>(map.size()));
+
+	return true;
+}
+
+std::uintmax_t ostream::transfer_(int fd, std::uintmax_t n) {
+	std::uintmax_t l = 0;
+	if(auto* const out = dynamic_cast<fdbuf*>(this->buf_.base()); out != nullptr) {
+		l = out->transfer_from(fd, n);
+	} else if(auto* const out = dynamic_cast<uring_fdbuf*>(this->buf_.base()); out != nullptr) {
+		l = out->transfer_from(fd, n);
+	}
+
+	this->buf_.bypassed(static_cast<std::streamsize>(l));
+	return l;
+}
+
 void ostream::seal_() {
+	if(this->body_begin_ != -1) {
+		auto const size = static_cast<std::uintmax_t>(this->buf_.count() - this->body_begin_);
+
+		this->body_begin_ = -1;
+		if(size != this->body_size_) [[unlikely]] {
+			throw std::system_error(std::make_error_code(std::errc::invalid_argument), "size of the body differs from the one given");
+		}
+
+		std::fill_n(std::ostream_iterator<char>(*this), padded_size(size) - size, 0);
+		return;
+	}
+	if(this->header_pos_ == -1) {
+		return;
+	}
+
 	auto const cur = this->tellp();
 
 	if(auto const size = cur - (this->header_pos_ + static_cast<off_type>(sizeof(header))); size < 0) {
 		throw std::system_error(std::make_error_code(std::errc::invalid_seek));
 	} else {
 		detail::marshal(size, this->header_cur_.size);
-
-		auto const* begin = reinterpret_cast<std::uint8_t*>(&this->header_cur_);
-		auto const  sum   = std::accumulate(begin, begin + sizeof(header), 0);
-		detail::marshal(sum, this->header_cur_.chksum, 6);
-		this->header_cur_.chksum[6] = '\0';
-		this->header_cur_.chksum[7] = ' ';
+		update_checksum(this->header_cur_);
 	}
 
 	this->seekp(this->header_pos_ + static_cast<off_type>(offsetof(header, size)));
-	this->write(this->header_cur_.size.data(), this->header_cur_.size.size() - 1);
+	this->write(this->header_cur_.size.data(), this->header_cur_.size.size());  // Whole field as it may be in base-256.
 
 	this->seekp(this->header_pos_ + static_cast<off_type>(offsetof(header, chksum)));
 	this->write(this->header_cur_.chksum.data(), this->header_cur_.chksum.size() - 1);
 
-	auto const pad_size = BlockSize - (cur % BlockSize);
+	auto const pad_size = (BlockSize - (cur % BlockSize)) % BlockSize;
 	this->seekp(cur);
 	std::fill_n(std::ostream_iterator<char>(*this), pad_size, 0);
+
+	this->header_pos_ = -1;
 }
 
 }  // namespace ustar
@@ -0,0 +1,32 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <tar/detail/checksum.hpp>
+
+TEST_CASE("sum_block") {
+	using tar::detail::SumBlockSize;
+
+	std::array<std::uint8_t, SumBlockSize + 1> data;
+	std::iota(data.begin(), data.end(), 0);
+
+	// Unaligned.
+	auto const* p = data.data() + 1;
+
+	std::uint32_t expected = 0;
+	for(std::size_t i = 0; i < SumBlockSize; ++i) {
+		expected += p[i];
+	}
+
+	CHECK(expected == tar::detail::sum_block_scalar(p));
+	CHECK(expected == tar::detail::sum_block(p));
+#if defined(__x86_64__) || defined(__i386__)
+	CHECK(expected == tar::detail::sum_block_sse2(p));
+	if(tar::detail::has_avx2()) {
+		CHECK(expected == tar::detail::sum_block_avx2(p));
+	}
+#endif
+}
@@ -0,0 +1,172 @@
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <tar/compress.hpp>
+#include <tar/ustar.hpp>
+
+#include <zlib.h>
+
+namespace {
+
+// Decompresses concatenated gzip members.
+std::string gunzip(std::string const& data, std::size_t* members = nullptr) {
+	::z_stream s = {};
+	REQUIRE(Z_OK == ::inflateInit2(&s, 15 + 16));
+
+	s.next_in  = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+	s.avail_in = static_cast<uInt>(data.size());
+
+	std::string out;
+	std::size_t n = 0;
+	while(s.avail_in > 0) {
+		char buf[4096];
+		s.next_out  = reinterpret_cast<Bytef*>(buf);
+		s.avail_out = sizeof(buf);
+
+		auto const ret = ::inflate(&s, Z_NO_FLUSH);
+		REQUIRE((ret == Z_OK || ret == Z_STREAM_END));
+		out.append(buf, sizeof(buf) - s.avail_out);
+		if(ret == Z_STREAM_END) {
+			++n;
+			::inflateReset(&s);
+		}
+	}
+	::inflateEnd(&s);
+
+	if(members != nullptr) {
+		*members = n;
+	}
+	return out;
+}
+
+}  // namespace
+
+TEST_CASE("compress_streambuf") {
+	std::stringbuf dst;
+
+	SECTION("empty stream is a valid member") {
+		{
+			tar::compress_streambuf buf(&dst);
+		}
+
+		std::size_t members;
+		CHECK("" == gunzip(dst.str(), &members));
+		CHECK(1 == members);
+	}
+
+	SECTION("blocks are written in order") {
+		std::string data;
+		for(std::size_t i = 0; data.size() < 100 * 1024; ++i) {
+			data += std::to_string(i * 7919) + ' ';
+		}
+
+		tar::compress_streambuf buf(&dst, {.block_size = 4096, .threads = 3});
+		{
+			std::ostream o(&buf);
+			o.write(data.data(), 1000);
+			o << data.substr(1000, 10);
+			o.write(data.data() + 1010, data.size() - 1010);
+			CHECK(data.size() == static_cast<std::size_t>(o.tellp()));
+		}
+		buf.finish();
+		CHECK(dst.str().size() == buf.compressed_size());
+
+		std::size_t members;
+		CHECK(data == gunzip(dst.str(), &members));
+		CHECK(members == (data.size() + 4095) / 4096);
+	}
+
+	SECTION("sync ends the current block") {
+		tar::compress_streambuf buf(&dst, {.block_size = 4096});
+
+		std::ostream o(&buf);
+		o << "Royale with Cheese" << std::flush;
+		CHECK("Royale with Cheese" == gunzip(dst.str()));
+
+		o << "Le Big Mac";
+		buf.finish();
+
+		std::size_t members;
+		CHECK("Royale with CheeseLe Big Mac" == gunzip(dst.str(), &members));
+		CHECK(2 == members);
+	}
+
+	SECTION("under ustar::ostream") {
+		std::string const body(10000, 'x');
+		{
+			tar::compress_streambuf buf(&dst, {.block_size = 4096, .threads = 2});
+			{
+				tar::ustar::ostream o(&buf);
+				o.next(tar::header{.path = "Burger"}, body.size());
+				o << body;
+			}
+		}
+
+		std::stringstream archive(gunzip(dst.str()));
+		tar::ustar::istream i(archive.rdbuf());
+
+		tar::header h;
+		REQUIRE(static_cast<bool>(i.next(h)));
+		CHECK("Burger" == h.path);
+
+		std::stringstream ss;
+		ss << i.rdbuf();
+		CHECK(body == ss.str());
+	}
+
+	SECTION("unsupported codec") {
+		if(!tar::supports(tar::codec::zstd)) {
+			CHECK_THROWS_AS(tar::compress_streambuf(&dst, {.codec = tar::codec::zstd}), std::system_error);
+		}
+	}
+}
+
+TEST_CASE("decompress_streambuf") {
+	std::string data;
+	for(std::size_t i = 0; data.size() < 100 * 1024; ++i) {
+		data += std::to_string(i * 7919) + ' ';
+	}
+
+	std::stringbuf dst;
+	{
+		tar::compress_streambuf buf(&dst, {.block_size = 16 * 1024});
+		std::ostream(&buf).write(data.data(), static_cast<std::streamsize>(data.size()));
+	}
+	auto const compressed = dst.str();
+
+	SECTION("whole stream") {
+		std::stringbuf            src(compressed);
+		tar::decompress_streambuf buf(&src, tar::codec::gzip, 1000);
+		std::istream              i(&buf);
+		std::stringstream         out;
+		out << i.rdbuf();
+		CHECK(data == out.str());
+		CHECK_FALSE(i.bad());
+	}
+
+	SECTION("truncated stream") {
+		std::stringbuf            src(compressed.substr(0, compressed.size() / 2));
+		tar::decompress_streambuf buf(&src, tar::codec::gzip, 1000);
+		std::istream              i(&buf);
+
+		std::string out(data.size(), '\0');
+		i.read(out.data(), static_cast<std::streamsize>(out.size()));
+		CHECK(i.bad());
+	}
+
+	SECTION("truncated in the trailer") {
+		std::stringbuf            src(compressed.substr(0, compressed.size() - 4));
+		tar::decompress_streambuf buf(&src, tar::codec::gzip);
+		std::istream              i(&buf);
+
+		std::string out(data.size() + 1, '\0');
+		i.read(out.data(), static_cast<std::streamsize>(out.size()));
+		CHECK(i.bad());
+	}
+}
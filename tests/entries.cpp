@@ -0,0 +1,120 @@
+#include <cstddef>
+#include <iterator>
+#include <ranges>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include <tar/entries.hpp>
+#include <tar/ustar.hpp>
+
+namespace {
+
+// Counts characters read, optionally refusing to seek.
+class counting_buf: public std::stringbuf {
+   public:
+	counting_buf(std::string s, bool seekable)
+	    : std::stringbuf(std::move(s))
+	    , seekable_(seekable) { }
+
+	std::streamsize read = 0;
+
+   protected:
+	std::streamsize xsgetn(char_type* s, std::streamsize count) override {
+		auto const n = std::stringbuf::xsgetn(s, count);
+		this->read += n;
+		return n;
+	}
+
+	int_type uflow() override {
+		++this->read;
+		return std::stringbuf::uflow();
+	}
+
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+		if(!this->seekable_) {
+			return pos_type(off_type(-1));
+		}
+		return std::stringbuf::seekoff(off, dir, which);
+	}
+
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+		if(!this->seekable_) {
+			return pos_type(off_type(-1));
+		}
+		return std::stringbuf::seekpos(pos, which);
+	}
+
+   private:
+	bool seekable_;
+};
+
+}  // namespace
+
+static_assert(std::ranges::input_range<tar::ustar::entry_range>);
+static_assert(std::ranges::view<tar::ustar::entry_range>);
+
+TEST_CASE("entries") {
+	std::size_t const large = 1024 * 1024;
+
+	std::stringstream archive;
+	{
+		tar::ustar::ostream o(archive.rdbuf());
+		for(auto const* name: {"foo/a", "foo/b", "bar/c", "foo/d", "bar/e"}) {
+			o.next(tar::header{.path = name, .type = tar::file_type::regular}, large);
+			o << std::string(large, name[4]);
+		}
+		o.next(tar::header{.path = "foo/f"}, 18);
+		o << "Royale with Cheese";
+	}
+
+	SECTION("filtered") {
+		auto const seekable = GENERATE(true, false);
+		CAPTURE(seekable);
+
+		counting_buf        buf(archive.str(), seekable);
+		tar::ustar::istream i(&buf);
+
+		auto const in_bar = [](tar::ustar::entry const& e) {
+			return e.path().parent_path() == "bar";
+		};
+
+		std::vector<std::string> names;
+		for(auto const& e: tar::ustar::entries(i) | std::views::filter(in_bar) | std::views::take(1)) {
+			names.push_back(e.path().string());
+			CHECK(large == e.size());
+			CHECK(tar::file_type::regular == e.type());
+			CHECK('c' == e.body().get());
+		}
+		CHECK(std::vector<std::string>{"bar/c"} == names);
+
+		// Bodies of dropped entries are not read if the stream is seekable.
+		if(seekable) {
+			CHECK(buf.read < static_cast<std::streamsize>(large));
+		}
+	}
+
+	SECTION("all") {
+		tar::ustar::istream i(archive.rdbuf());
+
+		std::vector<std::string> names;
+		for(auto const& e: tar::ustar::entries(i)) {
+			names.push_back(e.path().string());
+			if(e.size() < large) {
+				auto const h = e.header();
+				CHECK("foo/f" == h.path);
+				CHECK(18 == h.size);
+
+				std::string body(h.size, '\0');
+				e.body().read(body.data(), static_cast<std::streamsize>(body.size()));
+				CHECK("Royale with Cheese" == body);
+			}
+		}
+		CHECK(std::vector<std::string>{"foo/a", "foo/b", "bar/c", "foo/d", "bar/e", "foo/f"} == names);
+		CHECK(i.eof());
+		CHECK_FALSE(i.bad());
+	}
+}
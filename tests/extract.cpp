@@ -0,0 +1,207 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <tar/extract.hpp>
+#include <tar/patterns.hpp>
+#include <tar/ustar.hpp>
+
+namespace {
+
+std::string read_file(std::filesystem::path const& p) {
+	std::ifstream     f(p, std::ios::binary);
+	std::stringstream ss;
+	ss << f.rdbuf();
+	return ss.str();
+}
+
+// `tar::header::last_write_time` counts from the Unix epoch.
+std::chrono::seconds unix_time(std::filesystem::path const& p) {
+	auto const t = std::chrono::file_clock::to_sys(std::filesystem::last_write_time(p));
+	return std::chrono::duration_cast<std::chrono::seconds>(t.time_since_epoch());
+}
+
+}  // namespace
+
+TEST_CASE("extract") {
+	using std::filesystem::perms;
+
+	auto const root = std::filesystem::temp_directory_path() / "tar-test-extract";
+	auto const src  = root / "src.tar";
+	auto const dst  = root / "dst";
+	std::filesystem::remove_all(root);
+	std::filesystem::create_directories(root);
+
+	auto const mtime = std::filesystem::file_time_type(std::chrono::seconds(1234567890));
+
+	std::string const large(1000, 'x');
+	{
+		std::ofstream       f(src, std::ios::binary);
+		tar::ustar::ostream o(f.rdbuf());
+		o.next(tar::header{.path = "foo/", .permissions = perms(0555), .last_write_time = mtime, .type = tar::file_type::directory});
+		o.next(tar::header{.path = "foo/bar", .permissions = perms(0640), .last_write_time = mtime});
+		o << "Royale with Cheese";
+		o.next(tar::header{.path = "foo/large", .permissions = perms(0600), .last_write_time = mtime});
+		o << large;
+		o.next(tar::header{.path = "baz/qux", .permissions = perms(0644)});
+		o << "Le Big Mac";
+		o.next(tar::header{.path = "foo/hard", .type = tar::file_type::hard, .link = "foo/bar"});
+		o.next(tar::header{.path = "/foo/sym", .type = tar::file_type::symlink, .link = "bar"});
+	}
+
+	tar::ustar::extract(src, dst, {.threads = 3, .chunk_size = 300});
+
+	CHECK("Royale with Cheese" == read_file(dst / "foo/bar"));
+	CHECK(large == read_file(dst / "foo/large"));
+	CHECK("Le Big Mac" == read_file(dst / "baz/qux"));
+	CHECK("Royale with Cheese" == read_file(dst / "foo/hard"));
+	CHECK(std::filesystem::equivalent(dst / "foo/bar", dst / "foo/hard"));
+	CHECK("bar" == std::filesystem::read_symlink(dst / "foo/sym"));
+
+	CHECK(perms(0640) == std::filesystem::status(dst / "foo/bar").permissions());
+	CHECK(perms(0600) == std::filesystem::status(dst / "foo/large").permissions());
+	CHECK(perms(0555) == std::filesystem::status(dst / "foo").permissions());
+	CHECK(mtime.time_since_epoch() == unix_time(dst / "foo/large"));
+	CHECK(mtime.time_since_epoch() == unix_time(dst / "foo"));
+
+	std::filesystem::permissions(dst / "foo", perms::owner_all, std::filesystem::perm_options::add);
+	std::filesystem::remove_all(root);
+}
+
+TEST_CASE("extract selected by patterns") {
+	auto const root = std::filesystem::temp_directory_path() / "tar-test-extract-patterns";
+	auto const src  = root / "src.tar";
+	auto const dst  = root / "dst";
+	std::filesystem::remove_all(root);
+	std::filesystem::create_directories(root);
+	{
+		std::ofstream       f(src, std::ios::binary);
+		tar::ustar::ostream o(f.rdbuf());
+		for(auto const* p: {"foo/bar", "foo/large", "baz/qux", "qux"}) {
+			o.next(tar::header{.path = p});
+			o << p;
+		}
+	}
+
+	tar::pattern_set s;
+	s.include("foo");
+	s.include("baz/q*");
+	s.exclude("foo/large");
+	tar::ustar::extract(src, dst, {.patterns = &s});
+
+	CHECK("foo/bar" == read_file(dst / "foo/bar"));
+	CHECK("baz/qux" == read_file(dst / "baz/qux"));
+	CHECK_FALSE(std::filesystem::exists(dst / "foo/large"));
+	CHECK_FALSE(std::filesystem::exists(dst / "qux"));
+
+	std::filesystem::remove_all(root);
+}
+
+TEST_CASE("extract rejects path escaping destination") {
+	auto const root = std::filesystem::temp_directory_path() / "tar-test-extract-escape";
+	auto const src  = root / "src.tar";
+	std::filesystem::remove_all(root);
+	std::filesystem::create_directories(root);
+	{
+		std::ofstream       f(src, std::ios::binary);
+		tar::ustar::ostream o(f.rdbuf());
+		o.next(tar::header{.path = "foo/../../bar"});
+	}
+
+	CHECK_THROWS_AS(tar::ustar::extract(src, root / "dst"), std::system_error);
+	CHECK_FALSE(std::filesystem::exists(root / "bar"));
+
+	std::filesystem::remove_all(root);
+}
+
+TEST_CASE("extract does not follow symbolic links out of destination") {
+	auto const root    = std::filesystem::temp_directory_path() / "tar-test-extract-symlink";
+	auto const src     = root / "src.tar";
+	auto const dst     = root / "dst";
+	auto const outside = root / "outside";
+	std::filesystem::remove_all(root);
+	std::filesystem::create_directories(outside);
+	std::ofstream(outside / "secret") << "Royale with Cheese";
+
+	auto const write = [&](auto&& f) {
+		std::ofstream       file(src, std::ios::binary);
+		tar::ustar::ostream o(file.rdbuf());
+		f(o);
+	};
+
+	SECTION("symbolic link under an extracted one") {
+		write([&](auto& o) {
+			o.next(tar::header{.path = "a", .type = tar::file_type::symlink, .link = outside.string()});
+			o.next(tar::header{.path = "a/x", .type = tar::file_type::symlink, .link = "y"});
+		});
+
+		CHECK_THROWS_AS(tar::ustar::extract(src, dst), std::system_error);
+		CHECK_FALSE(std::filesystem::is_symlink(outside / "x"));
+	}
+
+	SECTION("hard link to a file under an extracted symbolic link") {
+		write([&](auto& o) {
+			o.next(tar::header{.path = "a", .type = tar::file_type::symlink, .link = outside.string()});
+			o.next(tar::header{.path = "x", .type = tar::file_type::hard, .link = "a/secret"});
+		});
+
+		CHECK_THROWS_AS(tar::ustar::extract(src, dst), std::system_error);
+		CHECK_FALSE(std::filesystem::exists(dst / "x"));
+	}
+
+	SECTION("file under a symbolic link already in destination") {
+		write([&](auto& o) {
+			o.next(tar::header{.path = "a/secret"});
+			o << "Le Big Mac";
+		});
+		std::filesystem::create_directories(dst);
+		std::filesystem::create_directory_symlink(outside, dst / "a");
+
+		CHECK_THROWS_AS(tar::ustar::extract(src, dst), std::system_error);
+		CHECK("Royale with Cheese" == read_file(outside / "secret"));
+	}
+
+	std::filesystem::remove_all(root);
+}
+
+TEST_CASE("extract sparse file") {
+	auto const root = std::filesystem::temp_directory_path() / "tar-test-extract-sparse";
+	auto const src  = root / "src.tar";
+	auto const file = root / "sparse";
+	std::filesystem::remove_all(root);
+	std::filesystem::create_directories(root);
+
+	std::uintmax_t constexpr Size = 64 * 1024 * 1024;
+	{
+		std::ofstream f(file, std::ios::binary);
+		f.seekp(16 * 1024 * 1024);
+		f << "Royale with Cheese";
+		f.seekp(Size - 10);
+		f << "Le Big Mac";
+	}
+	std::filesystem::resize_file(file, Size);
+	{
+		std::ofstream       f(src, std::ios::binary);
+		tar::ustar::ostream o(f.rdbuf());
+		o.next(file, "sparse");
+	}
+
+	// Holes are not stored.
+	CHECK(std::filesystem::file_size(src) < Size / 2);
+
+	tar::ustar::extract(src, root / "dst", {.chunk_size = 1024});
+
+	auto const extracted = read_file(root / "dst/sparse");
+	REQUIRE(Size == extracted.size());
+	CHECK("Royale with Cheese" == extracted.substr(16 * 1024 * 1024, 18));
+	CHECK("Le Big Mac" == extracted.substr(Size - 10));
+	CHECK(std::string(1024, '\0') == extracted.substr(0, 1024));
+	CHECK(read_file(file) == extracted);
+
+	std::filesystem::remove_all(root);
+}
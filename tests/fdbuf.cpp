@@ -0,0 +1,74 @@
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <tar/fdbuf.hpp>
+#include <tar/ustar.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+TEST_CASE("fdbuf") {
+	auto const path = std::filesystem::temp_directory_path() / "tar-test-fdbuf";
+
+	auto const fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	REQUIRE(fd >= 0);
+	{
+		tar::fdbuf   buf(fd, 4);
+		std::iostream s(&buf);
+
+		s << "0123456789";
+		REQUIRE(10 == s.tellp());
+
+		s.seekg(2);
+		std::array<char, 3> r;
+		s.read(r.data(), r.size());
+		REQUIRE("234" == std::string(r.begin(), r.end()));
+		REQUIRE(5 == s.tellg());
+
+		s << "abc";
+		s.seekg(0);
+
+		std::string v;
+		s >> v;
+		REQUIRE("01234abc89" == v);
+	}
+	::close(fd);
+
+	std::filesystem::remove(path);
+}
+
+TEST_CASE("ostream over fdbuf") {
+	auto const data_root = std::filesystem::path(__FILE__).parent_path() / "data";
+	auto const path      = std::filesystem::temp_directory_path() / "tar-test-fdbuf.tar";
+
+	auto const write = [&](std::ostream& o) {
+		tar::ustar::ostream a(o.rdbuf());
+		for(auto const name: {"Quentin Tarantino", "Christoph Waltz"}) {
+			a.next(data_root / name, name);
+		}
+	};
+
+	std::stringstream expected;
+	write(expected);
+
+	auto const fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	REQUIRE(fd >= 0);
+	{
+		tar::fdbuf   buf(fd);
+		std::ostream o(&buf);
+		write(o);
+	}
+	::close(fd);
+
+	std::stringstream result;
+	result << std::ifstream(path, std::ios::binary).rdbuf();
+	REQUIRE(expected.str() == result.str());
+
+	std::filesystem::remove(path);
+}
@@ -0,0 +1,176 @@
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <zlib.h>
+
+#include <tar/compress.hpp>
+#include <tar/gzip_index.hpp>
+#include <tar/ustar.hpp>
+
+namespace {
+
+std::string read_body(tar::ustar::istream& i) {
+	std::stringstream ss;
+	ss << i.rdbuf();
+	return ss.str();
+}
+
+// Text that compresses into many deflate blocks.
+std::string text_of(std::size_t n, std::uint32_t seed) {
+	static char const* const words[] = {"Royale", "with", "Cheese", "Le", "Big", "Mac", "Burger", "Fries", "Mayo", "Paris"};
+
+	std::string v;
+	while(v.size() < n) {
+		seed = seed * 1664525 + 1013904223;
+		v += words[(seed >> 16) % std::size(words)];
+		v += (seed & 0x100) ? ' ' : '\n';
+	}
+	v.resize(n);
+	return v;
+}
+
+// Compresses `data` into a single gzip member as `gzip` does.
+std::string gzip(std::string const& data) {
+	::z_stream s = {};
+	REQUIRE(Z_OK == ::deflateInit2(&s, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY));
+
+	std::string out(::deflateBound(&s, data.size()), '\0');
+	s.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+	s.avail_in  = static_cast<uInt>(data.size());
+	s.next_out  = reinterpret_cast<Bytef*>(out.data());
+	s.avail_out = static_cast<uInt>(out.size());
+	REQUIRE(Z_STREAM_END == ::deflate(&s, Z_FINISH));
+
+	out.resize(s.total_out);
+	::deflateEnd(&s);
+	return out;
+}
+
+}  // namespace
+
+TEST_CASE("gzip index") {
+	std::vector<std::string> bodies;
+	for(std::uint32_t i = 0; i < 40; ++i) {
+		bodies.push_back(text_of(20000 + i * 1000, i));
+	}
+
+	std::stringstream plain;
+	{
+		tar::ustar::ostream o(plain.rdbuf());
+		for(std::size_t i = 0; i < bodies.size(); ++i) {
+			o.next(tar::header{.path = "entry-" + std::to_string(i)}, bodies[i].size());
+			o << bodies[i];
+		}
+	}
+
+	auto const check_entries = [&](tar::ustar::gzip_index const& index) {
+		REQUIRE(bodies.size() == index.entries().size());
+		for(std::size_t i = bodies.size(); i-- > 0;) {
+			auto const path = "entry-" + std::to_string(i);
+			CHECK(path == index.path(index.entries()[i]));
+
+			auto s = index.open(path);
+
+			tar::header h;
+			REQUIRE(static_cast<bool>(s->next(h)));
+			CHECK(path == h.path);
+			CHECK(bodies[i] == read_body(*s));
+		}
+	};
+
+	SECTION("single member") {
+		std::stringstream archive(gzip(plain.str()));
+
+		tar::ustar::gzip_index const index(archive.rdbuf(), 32 * 1024);
+
+		// Checkpoints are in the middle of the member.
+		REQUIRE(index.checkpoints().size() > 5);
+		CHECK(0 == index.checkpoints()[0].out);
+		for(auto const& c: index.checkpoints().subspan(1)) {
+			CHECK(tar::ustar::gzip_index::WindowSize == c.window_size);
+		}
+
+		check_entries(index);
+
+		SECTION("entry after the last checkpoint reads the rest of the archive") {
+			auto s = index.open(index.entries().back());
+
+			tar::header h;
+			REQUIRE(static_cast<bool>(s->next(h)));
+			read_body(*s);
+			CHECK_FALSE(static_cast<bool>(s->next(h)));
+			CHECK(s->eof());
+		}
+	}
+
+	SECTION("concatenated members") {
+		std::stringstream archive;
+		{
+			tar::compress_streambuf buf(archive.rdbuf(), {.block_size = 64 * 1024});
+			buf.sputn(plain.str().data(), static_cast<std::streamsize>(plain.str().size()));
+		}
+
+		tar::ustar::gzip_index const index(archive.rdbuf(), 48 * 1024);
+		CHECK(index.checkpoints().size() > 10);
+
+		check_entries(index);
+	}
+
+	SECTION("saved and loaded") {
+		std::stringstream archive(gzip(plain.str()));
+
+		std::stringstream saved;
+		tar::ustar::gzip_index(archive.rdbuf(), 64 * 1024).save(saved.rdbuf());
+
+		archive.seekg(0);
+		auto const index = tar::ustar::gzip_index::load(archive.rdbuf(), saved.rdbuf());
+		CHECK(index.checkpoints().size() > 5);
+
+		check_entries(index);
+
+		SECTION("for another archive") {
+			std::stringstream other(gzip(plain.str() + std::string(1024, '\0')));
+
+			saved.seekg(0);
+			CHECK_THROWS_AS(tar::ustar::gzip_index::load(other.rdbuf(), saved.rdbuf()), std::system_error);
+		}
+	}
+
+	SECTION("not gzip") {
+		CHECK_THROWS_AS(tar::ustar::gzip_index(plain.rdbuf()), std::system_error);
+	}
+}
+
+TEST_CASE("gzip index of sparse file") {
+	std::string const data = "Royale with Cheese";
+
+	std::stringstream plain;
+	{
+		tar::ustar::ostream o(plain.rdbuf());
+		o.next(tar::header{.path = "before"}, 3);
+		o << "Mia";
+
+		tar::extent const extents[] = {{.offset = 1024 * 1024, .size = data.size()}};
+		REQUIRE(o.next_sparse(tar::header{.path = "dir/sparse", .size = 2 * 1024 * 1024}, extents));
+		o << data;
+	}
+
+	std::stringstream            archive(gzip(plain.str()));
+	tar::ustar::gzip_index const index(archive.rdbuf());
+	REQUIRE(2 == index.entries().size());
+	CHECK("dir/sparse" == index.path(index.entries()[1]));
+
+	auto s = index.open("dir/sparse");
+
+	tar::header h;
+	REQUIRE(static_cast<bool>(s->next(h)));
+	CHECK("dir/sparse" == h.path);
+	CHECK(s->sparse());
+	CHECK(2 * 1024 * 1024 == s->real_size());
+}
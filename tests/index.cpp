@@ -0,0 +1,84 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <tar/index.hpp>
+#include <tar/ustar.hpp>
+
+TEST_CASE("index") {
+	auto const data_root = std::filesystem::path(__FILE__).parent_path() / "data";
+
+	std::ifstream input(data_root / "Django Unchained.tar", std::ios::binary);
+
+	tar::ustar::index const index(input.rdbuf());
+	REQUIRE(5 == index.size());
+	CHECK("Quentin Tarantino" == index.path(index.entries()[0]));
+	CHECK("Leonardo DiCaprio" == index.path(index.entries()[4]));
+
+	SECTION("find") {
+		auto const* e = index.find("Jamie Foxx");
+		REQUIRE(nullptr != e);
+		CHECK(tar::file_type::regular == e->type);
+		CHECK(std::string("December 13, 1967\n").size() == e->size);
+		CHECK(e->header_offset + tar::ustar::BlockSize == e->body_offset);
+
+		CHECK(nullptr == index.find("Uma Thurman"));
+	}
+
+	SECTION("open") {
+		// Out of order.
+		for(auto const& [name, body]: {
+		        std::pair{"Samuel Jackson", "December 21, 1948\n"},
+		        std::pair{"Christoph Waltz", "October 4, 1956\n"},
+		        std::pair{"Leonardo DiCaprio", "November 11, 1974\n"},
+		    }) {
+			CAPTURE(name);
+
+			auto i = index.open(name);
+
+			std::stringstream ss;
+			ss << i.rdbuf();
+			CHECK(body == ss.str());
+		}
+
+		CHECK_THROWS_AS(index.open("Uma Thurman"), std::system_error);
+	}
+}
+
+TEST_CASE("index of written archive") {
+	std::stringstream stream;
+	{
+		tar::ustar::ostream o(stream.rdbuf());
+		o.next(tar::header{.path = "foo", .type = tar::file_type::directory});
+		o.next(tar::header{.path = "foo/bar"});
+		o << std::string(tar::ustar::BlockSize, 'a');
+		o.next(tar::header{.path = std::string(60, 'b') + "/" + std::string(60, 'c')});
+		o << "Royale with Cheese";
+		o.next(tar::header{.path = "foo/bar"});
+		o << "Le Big Mac";
+	}
+
+	tar::ustar::index const index(stream.rdbuf());
+	REQUIRE(4 == index.size());
+
+	auto const* e = index.find("foo");
+	REQUIRE(nullptr != e);
+	CHECK(tar::file_type::directory == e->type);
+	CHECK(0 == e->size);
+
+	e = index.find(std::string(60, 'b') + "/" + std::string(60, 'c'));
+	REQUIRE(nullptr != e);
+	CHECK(18 == e->size);
+
+	// Later entry wins.
+	auto i = index.open("foo/bar");
+
+	std::stringstream ss;
+	ss << i.rdbuf();
+	CHECK("Le Big Mac" == ss.str());
+}
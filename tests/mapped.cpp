@@ -0,0 +1,132 @@
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <tar/index.hpp>
+#include <tar/mapped.hpp>
+#include <tar/ustar.hpp>
+
+namespace {
+
+std::string to_string(std::span<std::byte const> v) {
+	return std::string(reinterpret_cast<char const*>(v.data()), v.size());
+}
+
+}  // namespace
+
+TEST_CASE("mapped_archive") {
+	using tar::ustar::mapped_archive;
+
+	auto const data_root = std::filesystem::path(__FILE__).parent_path() / "data";
+	auto const path      = data_root / "Django Unchained.tar";
+
+	mapped_archive const archive(path, mapped_archive::access::sequential);
+	REQUIRE(std::filesystem::file_size(path) == archive.data().size());
+
+	SECTION("iterate") {
+		std::vector<std::pair<std::string, std::string>> const expected = {
+		    {"Quentin Tarantino", "March 27, 1963\n"},
+		    {"Christoph Waltz", "October 4, 1956\n"},
+		    {"Jamie Foxx", "December 13, 1967\n"},
+		    {"Samuel Jackson", "December 21, 1948\n"},
+		    {"Leonardo DiCaprio", "November 11, 1974\n"},
+		};
+
+		auto it = archive.begin();
+		for(auto const& [name, body]: expected) {
+			REQUIRE(it != archive.end());
+			CHECK(name == std::string(it->header().name.data()));
+			CHECK(body == to_string(it->body));
+
+			tar::header const h = tar::ustar::header(it->header());
+			CHECK(name == h.path);
+
+			++it;
+		}
+		CHECK(it == archive.end());
+	}
+
+	SECTION("at") {
+		std::ifstream           input(path, std::ios::binary);
+		tar::ustar::index const index(input.rdbuf());
+
+		auto const* e = index.find("Samuel Jackson");
+		REQUIRE(nullptr != e);
+
+		auto const entry = archive.at(e->header_offset);
+		archive.prefetch(entry);
+		CHECK("December 21, 1948\n" == to_string(entry.body));
+
+		CHECK_THROWS_AS(archive.at(archive.data().size()), std::system_error);
+	}
+}
+
+TEST_CASE("mapped_archive with PAX extended headers") {
+	using tar::ustar::mapped_archive;
+
+	auto const path = std::filesystem::temp_directory_path() / "tar-test-mapped-pax.tar";
+	{
+		std::ofstream       f(path, std::ios::binary);
+		tar::ustar::ostream o(f.rdbuf());
+		o.next(tar::header{.path = "Mia"}, 7);
+		o << "Wallace";
+
+		tar::extent const extents[] = {{.offset = 4096, .size = 4}};
+		REQUIRE(o.next_sparse(tar::header{.path = "dir/sparse", .size = 8192}, extents));
+		o << "Mayo";
+
+		o.next(tar::header{.path = "Vincent"}, 4);
+		o << "Vega";
+	}
+
+	SECTION("same entries as index") {
+		std::ifstream           input(path, std::ios::binary);
+		tar::ustar::index const index(input.rdbuf());
+
+		mapped_archive const archive(path);
+
+		auto it = archive.begin();
+		for(auto const& e: index.entries()) {
+			REQUIRE(it != archive.end());
+			CHECK(index.path(e) == it->path());
+			CHECK(e.header_offset == it->offset);
+			CHECK(e.size == it->body.size());
+			++it;
+		}
+		CHECK(it == archive.end());
+
+		CHECK_FALSE(std::next(archive.begin())->records.empty());
+		CHECK(archive.at(index.find("Vincent")->header_offset).records.empty());
+	}
+
+	SECTION("header checksum mismatch") {
+		{
+			std::fstream f(path, std::ios::binary | std::ios::in | std::ios::out);
+			f.seekp(0);
+			f << 'X';
+		}
+
+		mapped_archive const archive(path);
+		CHECK_THROWS_AS(archive.begin(), std::system_error);
+	}
+
+	std::filesystem::remove(path);
+}
+
+TEST_CASE("mapped_archive of empty file") {
+	auto const path = std::filesystem::temp_directory_path() / "tar-test-mapped-empty.tar";
+	std::ofstream{path};
+
+	tar::ustar::mapped_archive const archive(path);
+	CHECK(archive.data().empty());
+	CHECK(archive.begin() == archive.end());
+
+	std::filesystem::remove(path);
+}
@@ -0,0 +1,110 @@
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <tar/index.hpp>
+#include <tar/mapped_index.hpp>
+#include <tar/shared_archive.hpp>
+#include <tar/ustar.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+TEST_CASE("mapped_index") {
+	using tar::ustar::mapped_index;
+
+	auto const root = std::filesystem::temp_directory_path() / "tar-test-mapped_index";
+	std::filesystem::remove_all(root);
+	std::filesystem::create_directories(root);
+
+	auto const archive = root / "archive.tar";
+	auto const sidecar = tar::ustar::sidecar_path(archive);
+	CHECK(root / "archive.tar.index" == sidecar);
+	{
+		std::ofstream f(archive, std::ios::binary);
+
+		tar::ustar::ostream o(f.rdbuf());
+		for(auto const& name: std::initializer_list<std::string>{"vincent", "jules", "mia", std::string(60, 'w') + "/" + std::string(60, 'w'), "jules", "butch"}) {
+			auto const body = name + " body";
+			o.next(tar::header{.path = name, .type = tar::file_type::regular}, body.size());
+			o << body;
+		}
+		o.next(tar::header{.path = "jules", .type = tar::file_type::directory});
+	}
+
+	CHECK_THROWS_AS(mapped_index(sidecar, archive), std::system_error);
+
+	{
+		auto const built = mapped_index::open_or_build(archive, sidecar);
+		CHECK(std::filesystem::exists(sidecar));
+		CHECK(7 == built.size());
+	}
+
+	mapped_index const index(sidecar, archive);
+	REQUIRE(7 == index.size());
+	CHECK("vincent" == index.path(index.entries()[0]));
+	CHECK(std::string(60, 'w') + "/" + std::string(60, 'w') == index.path(index.entries()[3]));
+
+	SECTION("find") {
+		// The last one with the path.
+		auto const* e = index.find("jules");
+		REQUIRE(nullptr != e);
+		CHECK(&index.entries()[6] == e);
+		CHECK(tar::file_type::directory == e->type);
+
+		CHECK(nullptr == index.find("marsellus"));
+		CHECK(nullptr == index.find(""));
+		CHECK(nullptr == index.find("zed"));
+
+		// Same as the index it was written from.
+		std::ifstream           input(archive, std::ios::binary);
+		tar::ustar::index const expected(input.rdbuf());
+		for(auto const& x: expected.entries()) {
+			auto const* a = expected.find(expected.path(x));
+			auto const* e = index.find(expected.path(x));
+			REQUIRE(nullptr != e);
+			CHECK(a->body_offset == e->body_offset);
+			CHECK(a->size == e->size);
+		}
+	}
+
+	SECTION("read bodies") {
+		auto const fd = ::open(archive.c_str(), O_RDONLY);
+		REQUIRE(fd >= 0);
+		{
+			auto const*               e = index.find("mia");
+			tar::ustar::pread_istream s(fd, e->body_offset, e->body_offset + e->size);
+
+			std::stringstream r;
+			r << s.rdbuf();
+			CHECK("mia body" == r.str());
+		}
+		::close(fd);
+	}
+
+	SECTION("stale") {
+		std::ofstream(archive, std::ios::binary | std::ios::app) << std::string(tar::ustar::BlockSize, '\0');
+		CHECK_THROWS_AS(mapped_index(sidecar, archive), std::system_error);
+
+		auto const rebuilt = mapped_index::open_or_build(archive, sidecar);
+		CHECK(7 == rebuilt.size());
+		CHECK_NOTHROW(mapped_index(sidecar, archive));
+	}
+
+	SECTION("malformed") {
+		std::ofstream(sidecar, std::ios::binary) << "TARIDXM1";
+		CHECK_THROWS_AS(mapped_index(sidecar, archive), std::system_error);
+
+		std::ofstream(sidecar, std::ios::binary) << std::string(100, 'x');
+		CHECK_THROWS_AS(mapped_index(sidecar, archive), std::system_error);
+
+		CHECK(7 == mapped_index::open_or_build(archive, sidecar).size());
+	}
+
+	std::filesystem::remove_all(root);
+}
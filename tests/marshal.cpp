@@ -1,16 +1,18 @@
 #include <array>
 #include <cstddef>
-#include <numeric>
+#include <cstdint>
 #include <string>
 #include <system_error>
 #include <tuple>
 
+#include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/generators/catch_generators.hpp>
 #include <catch2/matchers/catch_matchers_exception.hpp>
 #include <catch2/matchers/catch_matchers_string.hpp>
 
 #include <tar/detail/marshal.hpp>
+#include <tar/detail/string.hpp>
 
 TEST_CASE("marshal string") {
 	using tar::detail::marshal;
@@ -68,16 +70,33 @@ TEST_CASE("marshal number") {
 		    {0, {'0', '0', '\0'}},
 		    {001, {'0', '1', '\0'}},
 		    {042, {'4', '2', '\0'}},
-		    {0123, {'1', '2', '\0'}},
 		    {01, {'0', '1', '\0'}},
 		    {001, {'0', '1', '\0'}},
 		    {042, {'4', '2', '\0'}},
-		    {0123, {'1', '2', '\0'}},
+
+		    // Does not fit in octal so written in base-256.
+		    {0123, {'\x80', '\0', '\x53'}},
+		    {0xFFFF, {'\x80', '\xFF', '\xFF'}},
 		}));
 
 		marshal(given, dst);
 		REQUIRE(expected == dst);
 	}
+
+	SECTION("negative") {
+		marshal(-2, dst);
+		REQUIRE(std::array<char, 3>{'\xFF', '\xFF', '\xFE'} == dst);
+	}
+
+	SECTION("size of 8 GiB or more") {
+		std::array<char, 12> size = {0};
+
+		marshal(077777777777ull, size);
+		CHECK(std::array<char, 12>{'7', '7', '7', '7', '7', '7', '7', '7', '7', '7', '7', '\0'} == size);
+
+		marshal(8ull << 30, size);
+		CHECK(std::array<char, 12>{'\x80', 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0} == size);
+	}
 }
 
 TEST_CASE("unmarshal number") {
@@ -99,6 +118,9 @@ TEST_CASE("unmarshal number") {
 
 		    {{'0', '2', '\0'}, 02},
 		    {{'0', '0', '3'}, 03},
+
+		    {{'\x80', '\0', '\x53'}, 0123},
+		    {{'\x81', '\0', '\0'}, 0x10000},
 		}));
 
 		CAPTURE(given);
@@ -156,3 +178,100 @@ TEST_CASE("split_ustar_path") {
 		REQUIRE_THROWS_MATCHES(split_ustar_path(over), std::system_error, MessageMatches(ContainsSubstring("too long")));
 	}
 }
+
+TEST_CASE("to_octal") {
+	using tar::detail::to_octal;
+
+	auto const octal = [](auto v, std::size_t w) {
+		std::array<char, 8> dst = {0};
+		to_octal(v, dst.data(), w);
+		return std::string(dst.data());
+	};
+
+	static_assert([] {
+		std::array<char, 4> dst = {0};
+		to_octal(042, dst.data(), 3);
+		return dst == std::array<char, 4>{'0', '4', '2', '\0'};
+	}());
+
+	CHECK("" == octal(042, 0));
+	CHECK("0" == octal(0, 1));
+	CHECK("0000" == octal(0, 4));
+	CHECK("0052" == octal(42, 4));
+	CHECK("12" == octal(0123, 2));
+	CHECK("7777777" == octal(07777777, 7));
+	CHECK("3777777" == octal(-1, 7));
+}
+
+TEST_CASE("from_octal") {
+	using tar::detail::from_octal;
+
+	static_assert(042 == from_octal("0042", 4));
+	static_assert(0 == from_octal("", 0));
+
+	CHECK(0 == from_octal("\0" "12", 3));
+	CHECK(012 == from_octal("12\0" "3", 4));
+	CHECK(012 == from_octal("  12 ", 5));
+	CHECK(012 == from_octal("0128", 4));
+	CHECK(0 == from_octal("x12", 3));
+
+	// Does not fit.
+	CHECK(0 == from_octal("7777777777777777777777777", 25));
+}
+
+TEST_CASE("base256") {
+	using tar::detail::from_base256;
+	using tar::detail::to_base256;
+
+	auto const round_trip = [](auto v) {
+		std::array<char, 12> dst = {0};
+		to_base256(v, dst.data(), dst.size());
+		return from_base256(dst.data(), dst.size());
+	};
+
+	static_assert(0x123 == from_base256("\x80\x01\x23", 3));
+
+	CHECK(0 == round_trip(0));
+	CHECK(1ull << 40 == round_trip(1ull << 40));
+	CHECK(UINTMAX_MAX == round_trip(UINTMAX_MAX));
+	CHECK(-1 == static_cast<std::intmax_t>(round_trip(-1)));
+	CHECK(-1234567890123 == static_cast<std::intmax_t>(round_trip(-1234567890123ll)));
+}
+
+TEST_CASE("marshal number benchmark") {
+	std::array<char, 12> dst = {0};
+
+	// What `marshal` and `unmarshal` used to do.
+	auto const marshal_with_stream = [](std::uintmax_t v, std::array<char, 12>& dst) {
+		tar::detail::to_octal_string(v, dst.size() - 1).copy(dst.data(), dst.size() - 1);
+	};
+	auto const unmarshal_with_stoul = [](std::array<char, 12> const& src, std::uintmax_t& v) {
+		std::string s;
+		tar::detail::unmarshal(src, s);
+		try {
+			v = s.empty() ? 0 : std::stoul(s, 0, 8);
+		} catch(...) {
+			v = 0;
+		}
+	};
+
+	std::uintmax_t v = 036251473625;
+
+	BENCHMARK("marshal with std::ostringstream") {
+		marshal_with_stream(v, dst);
+		return dst;
+	};
+	BENCHMARK("marshal") {
+		tar::detail::marshal(v, dst);
+		return dst;
+	};
+
+	BENCHMARK("unmarshal with std::stoul") {
+		unmarshal_with_stoul(dst, v);
+		return v;
+	};
+	BENCHMARK("unmarshal") {
+		tar::detail::unmarshal(dst, v);
+		return v;
+	};
+}
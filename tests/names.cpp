@@ -0,0 +1,71 @@
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <tar/io.hpp>
+#include <tar/names.hpp>
+
+#include <pwd.h>
+#include <unistd.h>
+
+TEST_CASE("name_cache") {
+	SECTION("preloaded names are used as they are") {
+		tar::name_cache names({{::getuid(), "alice"}}, {{::getgid(), "wheel"}});
+		REQUIRE("alice" == names.user_name(::getuid()));
+		REQUIRE("wheel" == names.group_name(::getgid()));
+	}
+
+	SECTION("resolves names from the system") {
+		auto const* const pw = ::getpwuid(::getuid());
+		REQUIRE(pw != nullptr);
+
+		std::string const expected = pw->pw_name;
+
+		tar::name_cache names;
+		REQUIRE(expected == names.user_name(::getuid()));
+
+		// Same entry is handed out once resolved.
+		auto const* const first = &names.user_name(::getuid());
+		REQUIRE(first == &names.user_name(::getuid()));
+	}
+
+	SECTION("unknown IDs resolve to an empty name") {
+		tar::name_cache names;
+		REQUIRE(names.user_name(0x7FFF'FFF0).empty());
+		REQUIRE(names.group_name(0x7FFF'FFF0).empty());
+	}
+
+	SECTION("concurrent lookups resolve to the same entry") {
+		tar::name_cache names;
+
+		std::vector<std::string const*> found(8);
+		{
+			std::vector<std::jthread> threads;
+			for(std::size_t i = 0; i < found.size(); ++i) {
+				threads.emplace_back([&, i] { found[i] = &names.group_name(::getgid()); });
+			}
+		}
+		for(auto const* p: found) {
+			REQUIRE(p == found[0]);
+		}
+	}
+
+	SECTION("header is filled through given cache") {
+		auto const path = std::filesystem::temp_directory_path() / "tar-test-names";
+		std::ofstream(path) << "Lorem ipsum";
+
+		tar::name_cache names({{::getuid(), "alice"}}, {{::getgid(), "wheel"}});
+
+		auto const h = tar::header_of(path, "a.txt", names);
+		REQUIRE("alice" == h.user_name);
+		REQUIRE("wheel" == h.group_name);
+
+		std::filesystem::remove(path);
+	}
+}
@@ -0,0 +1,141 @@
+#include <ranges>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <tar/entries.hpp>
+#include <tar/patterns.hpp>
+#include <tar/ustar.hpp>
+
+TEST_CASE("pattern_set") {
+	tar::pattern_set s;
+	CHECK(s.empty());
+	CHECK(s.selects("anything"));
+
+	SECTION("literal") {
+		s.include("usr/lib");
+		CHECK_FALSE(s.empty());
+
+		CHECK(s.selects("usr/lib"));
+		CHECK(s.selects("usr/lib/"));
+		CHECK(s.selects("usr/lib/libc.so"));
+		CHECK_FALSE(s.selects("usr/lib64"));
+		CHECK_FALSE(s.selects("usr"));
+		CHECK_FALSE(s.selects("var/usr/lib"));
+	}
+
+	SECTION("trailing '/'") {
+		s.include("usr/");
+		s.include("var/*/");
+
+		CHECK(s.selects("usr"));
+		CHECK(s.selects("usr/lib"));
+		CHECK(s.selects("usr/lib/libc.so"));
+		CHECK_FALSE(s.selects("usrx"));
+
+		CHECK(s.selects("var/log/syslog"));
+		CHECK_FALSE(s.selects("var"));
+	}
+
+	SECTION("wildcards") {
+		s.include("etc/*.conf");
+		s.include("bin/?s");
+		s.include("var/log/[a-c!]*");
+		s.include("opt/**/bin");
+		s.include("srv/**.html");
+		s.include("a\\*b");
+
+		CHECK(s.selects("etc/ld.so.conf"));
+		CHECK(s.selects("etc/.conf"));
+		CHECK_FALSE(s.selects("etc/ssh/sshd.conf"));
+		CHECK_FALSE(s.selects("etc/ld.so.confx"));
+
+		CHECK(s.selects("bin/ls"));
+		CHECK_FALSE(s.selects("bin/cat"));
+		CHECK_FALSE(s.selects("bin//s"));
+
+		CHECK(s.selects("var/log/apt/history.log"));
+		CHECK(s.selects("var/log/!x"));
+		CHECK_FALSE(s.selects("var/log/dmesg"));
+
+		CHECK(s.selects("opt/bin"));
+		CHECK(s.selects("opt/x/y/bin/tool"));
+		CHECK_FALSE(s.selects("opt/xbin"));
+
+		CHECK(s.selects("srv/www/a/index.html"));
+		CHECK_FALSE(s.selects("srv/www/index.htm"));
+
+		CHECK(s.selects("a*b"));
+		CHECK_FALSE(s.selects("axb"));
+	}
+
+	SECTION("negated class") {
+		s.include("[!.]*");
+		CHECK(s.selects("foo/.bar"));
+		CHECK_FALSE(s.selects(".foo"));
+		CHECK_FALSE(s.selects("/foo"));
+	}
+
+	SECTION("exclude") {
+		s.exclude("**/*.o");
+		s.exclude("build");
+		CHECK(s.selects("src/main.c"));
+		CHECK_FALSE(s.selects("main.o"));
+		CHECK_FALSE(s.selects("src/x/main.o"));
+		CHECK_FALSE(s.selects("build/out"));
+		CHECK(s.selects("builds"));
+
+		s.include("src");
+		CHECK(s.selects("src/main.c"));
+		CHECK_FALSE(s.selects("src/main.o"));
+		CHECK_FALSE(s.selects("docs/readme"));
+	}
+
+	SECTION("many patterns") {
+		for(int i = 0; i < 500; ++i) {
+			s.include("layer/" + std::to_string(i) + "/*.so");
+		}
+		s.include("layer/**/keep");
+
+		CHECK(s.selects("layer/123/libfoo.so"));
+		CHECK(s.selects("layer/499/a.so"));
+		CHECK_FALSE(s.selects("layer/500/a.so"));
+		CHECK_FALSE(s.selects("layer/12/x/a.so"));
+		CHECK(s.selects("layer/500/x/keep"));
+	}
+
+	SECTION("malformed") {
+		CHECK_THROWS_AS(s.include(""), std::system_error);
+		CHECK_THROWS_AS(s.include("foo\\"), std::system_error);
+		CHECK_THROWS_AS(s.include("foo[ab"), std::system_error);
+		CHECK_THROWS_AS(s.include("*" + std::string(tar::pattern_set::MaxTailSize, 'x')), std::system_error);
+		CHECK(s.empty());
+	}
+}
+
+TEST_CASE("pattern_set on headers") {
+	std::string const dir(80, 'd');
+
+	std::stringstream archive;
+	{
+		tar::ustar::ostream o(archive.rdbuf());
+		for(auto const& p: {dir + "/keep.txt", dir + "/drop.bin", std::string("top.txt")}) {
+			o.next(tar::header{.path = p, .type = tar::file_type::regular}, 1);
+			o << 'x';
+		}
+	}
+
+	tar::pattern_set s;
+	s.include("**.txt");
+
+	tar::ustar::istream i(archive.rdbuf());
+
+	std::vector<std::string> names;
+	for(auto const& e: tar::ustar::entries(i) | std::views::filter([&](auto const& e) { return s.selects(e.view()); })) {
+		names.push_back(e.path().string());
+	}
+	CHECK(std::vector<std::string>{dir + "/keep.txt", "top.txt"} == names);
+}
@@ -0,0 +1,121 @@
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <tar/compress.hpp>
+#include <tar/seekable.hpp>
+#include <tar/ustar.hpp>
+
+namespace {
+
+std::string read_body(tar::ustar::istream& i) {
+	std::stringstream ss;
+	ss << i.rdbuf();
+	return ss.str();
+}
+
+}  // namespace
+
+TEST_CASE("seekable archive") {
+	std::string const large(20000, 'x');
+
+	// Long enough to be split into the prefix and the name.
+	std::string const shake = std::string(100, 'd') + "/Shake";
+
+	std::stringstream archive;
+	{
+		tar::ustar::seekable_ostream o(archive.rdbuf(), {.block_size = 4096, .threads = 2});
+		o.next(tar::header{.path = "Burger", .size = 18}, 18);
+		o << "Royale with Cheese";
+		o.next(tar::header{.path = "large"}, large.size());
+		o << large;
+		o.next(tar::header{.path = "Fries", .size = 10}, 10);
+		o << "Le Big Mac";
+
+		// Through the base, whose overloads taking a ustar header are not virtual.
+		tar::ustar::ostream& base = o;
+		base.next(tar::ustar::header::from(tar::header{.path = shake}), 5);
+		base << "Vanil";
+
+		tar::extent const extents[] = {{.offset = 4096, .size = 4}};
+		REQUIRE(base.next_sparse(tar::header{.path = "Salt", .size = 8192}, extents));
+		base << "Mayo";
+
+		// Its header could not be patched.
+		CHECK_THROWS_AS(base.next(tar::header{.path = "Ketchup"}), std::system_error);
+	}
+
+	SECTION("decompresses to a plain archive") {
+		tar::decompress_streambuf buf(archive.rdbuf(), tar::codec::gzip);
+		tar::ustar::istream       i(&buf);
+
+		tar::header h;
+		REQUIRE(static_cast<bool>(i.next(h)));
+		CHECK("Burger" == h.path);
+		CHECK("Royale with Cheese" == read_body(i));
+		REQUIRE(static_cast<bool>(i.next(h)));
+		CHECK("large" == h.path);
+		REQUIRE(static_cast<bool>(i.next(h)));
+		CHECK("Fries" == h.path);
+		CHECK("Le Big Mac" == read_body(i));
+		REQUIRE(static_cast<bool>(i.next(h)));
+		CHECK(shake == h.path);
+		REQUIRE(static_cast<bool>(i.next(h)));
+		CHECK("Salt" == h.path);
+		CHECK(i.sparse());
+		CHECK_FALSE(static_cast<bool>(i.next(h)));
+		CHECK(i.eof());
+	}
+
+	SECTION("reads an entry without decompressing ones before it") {
+		tar::ustar::seekable_archive const a(archive.rdbuf());
+		CHECK(tar::codec::gzip == a.codec());
+		REQUIRE(5 == a.entries().size());
+		CHECK("large" == a.path(a.entries()[1]));
+
+		// Each entry starts a frame and the large one spans several.
+		CHECK(a.frames().size() > 5);
+
+		auto i = a.open("Fries");
+
+		tar::header h;
+		REQUIRE(static_cast<bool>(i->next(h)));
+		CHECK("Fries" == h.path);
+		CHECK("Le Big Mac" == read_body(*i));
+
+		i = a.open("large");
+		REQUIRE(static_cast<bool>(i->next(h)));
+		CHECK("large" == h.path);
+		CHECK(large == read_body(*i));
+
+		// Started by a header already made.
+		i = a.open(shake);
+		REQUIRE(static_cast<bool>(i->next(h)));
+		CHECK(shake == h.path);
+		CHECK("Vanil" == read_body(*i));
+
+		// Extended headers of a sparse file are in the member of its entry.
+		CHECK("Salt" == a.path(a.entries()[4]));
+		i = a.open("Salt");
+		REQUIRE(static_cast<bool>(i->next(h)));
+		CHECK("Salt" == h.path);
+		CHECK(i->sparse());
+		CHECK(8192 == i->real_size());
+
+		CHECK_THROWS_AS(a.open("Salad"), std::system_error);
+	}
+
+	SECTION("plain compressed stream has no seek table") {
+		std::stringstream plain;
+		{
+			tar::compress_streambuf   buf(plain.rdbuf());
+			tar::ustar::ostream o(&buf);
+			o.next(tar::header{.path = "Burger"}, 0);
+		}
+
+		CHECK_THROWS_AS(tar::ustar::seekable_archive(plain.rdbuf()), std::system_error);
+	}
+}
@@ -0,0 +1,115 @@
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <tar/shared_archive.hpp>
+#include <tar/ustar.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+std::string body_of(std::size_t i) {
+	std::string v((i % 7) * 30000 + i, '\0');
+	for(std::size_t j = 0; j < v.size(); ++j) {
+		v[j] = static_cast<char>('a' + (i + j * 13) % 26);
+	}
+	return v;
+}
+
+}  // namespace
+
+TEST_CASE("shared_archive") {
+	std::size_t const count = 32;
+
+	auto const path = std::filesystem::temp_directory_path() / "tar-test-shared_archive.tar";
+	{
+		std::ofstream f(path, std::ios::binary);
+
+		tar::ustar::ostream o(f.rdbuf());
+		for(std::size_t i = 0; i < count; ++i) {
+			auto const body = body_of(i);
+			o.next(tar::header{.path = "f" + std::to_string(i), .type = tar::file_type::regular}, body.size());
+			o << body;
+		}
+	}
+
+	tar::ustar::shared_archive const archive(path);
+	REQUIRE(count == archive.size());
+	CHECK("f3" == archive.path(archive.entries()[3]));
+	CHECK_THROWS_AS(archive.open("g"), std::system_error);
+
+	SECTION("concurrent") {
+		std::atomic<std::size_t> mismatches = 0;
+		{
+			std::vector<std::jthread> threads;
+			for(std::size_t t = 0; t < 4; ++t) {
+				threads.emplace_back([&, t] {
+					// Each thread walks the entries in a different order.
+					for(std::size_t k = 0; k < count * 4; ++k) {
+						auto const i = (k * (2 * t + 1) + t) % count;
+
+						auto s = archive.open("f" + std::to_string(i));
+
+						std::stringstream r;
+						r << s.rdbuf();
+						if(r.str() != body_of(i)) {
+							++mismatches;
+						}
+					}
+				});
+			}
+		}
+		CHECK(0 == mismatches);
+	}
+
+	SECTION("seek") {
+		auto const body = body_of(6);
+		auto       s    = archive.open("f6");
+
+		std::string r(100, '\0');
+		for(std::size_t const pos: {150000uz, 10uz, 70000uz, 70050uz, 0uz}) {
+			CAPTURE(pos);
+
+			s.seekg(static_cast<std::streamoff>(pos));
+			s.read(r.data(), static_cast<std::streamsize>(r.size()));
+			CHECK(body.substr(pos, r.size()) == r);
+			CHECK(static_cast<std::streamoff>(pos + r.size()) == s.tellg());
+		}
+
+		// Large read bypasses the buffer.
+		s.seekg(1);
+		r.resize(body.size() - 1);
+		s.read(r.data(), static_cast<std::streamsize>(r.size()));
+		CHECK(body.substr(1) == r);
+
+		CHECK(static_cast<std::streamoff>(body.size()) == s.seekg(0, std::ios_base::end).tellg());
+		CHECK(std::char_traits<char>::eof() == s.get());
+	}
+
+	SECTION("file descriptor") {
+		auto const fd = ::open(path.c_str(), O_RDONLY);
+		REQUIRE(fd >= 0);
+		{
+			tar::ustar::shared_archive const shared(fd);
+			REQUIRE(count == shared.size());
+
+			auto        s = shared.open(shared.entries()[1]);
+			std::string r;
+			std::getline(s, r, '\0');
+			CHECK(body_of(1) == r);
+		}
+		::close(fd);
+	}
+
+	std::filesystem::remove(path);
+}
@@ -0,0 +1,134 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <tar/detail/fd.hpp>
+#include <tar/detail/sparse.hpp>
+#include <tar/index.hpp>
+#include <tar/types.hpp>
+#include <tar/ustar.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+TEST_CASE("sparse map") {
+	std::vector<tar::extent> const extents = {{4096, 5}, {600000, 5}, {1048576, 0}};
+
+	auto const map = tar::detail::format_sparse_map(extents);
+	CHECK(tar::ustar::BlockSize == map.size());
+	CHECK(map.starts_with("3\n4096\n5\n600000\n5\n1048576\n0\n\0"));
+
+	std::vector<tar::extent> parsed;
+	CHECK(map.size() == tar::detail::parse_sparse_map(map + "data", parsed));
+	CHECK(extents == parsed);
+
+	SECTION("incomplete") {
+		CHECK(0 == tar::detail::parse_sparse_map("3\n4096\n5\n6000", parsed));
+		CHECK(0 == tar::detail::parse_sparse_map(map.substr(0, 100), parsed));
+	}
+
+	SECTION("malformed") {
+		CHECK_THROWS_AS(tar::detail::parse_sparse_map("x\n", parsed), std::system_error);
+		CHECK_THROWS_AS(tar::detail::parse_sparse_map(tar::detail::format_sparse_map(std::vector<tar::extent>{{10, 5}, {12, 1}}), parsed), std::system_error);
+	}
+}
+
+TEST_CASE("data_extents") {
+	auto const path = std::filesystem::temp_directory_path() / "tar-test-data-extents";
+	std::filesystem::remove(path);
+
+	tar::detail::unique_fd const fd(::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644));
+
+	SECTION("dense file") {
+		std::string const data(10000, 'x');
+		tar::detail::pwrite_full(fd.get(), data.data(), data.size(), 0);
+
+		auto const extents = tar::detail::data_extents(fd.get(), data.size());
+		REQUIRE(1 == extents.size());
+		CHECK(tar::extent{0, data.size()} == extents[0]);
+	}
+
+	SECTION("file with holes") {
+		std::uintmax_t constexpr Size = 64 * 1024 * 1024;
+		REQUIRE(0 == ::ftruncate(fd.get(), Size));
+
+		std::string const data(4096, 'x');
+		tar::detail::pwrite_full(fd.get(), data.data(), data.size(), 8 * 1024 * 1024);
+
+		auto const extents = tar::detail::data_extents(fd.get(), Size);
+		REQUIRE(!extents.empty());
+		CHECK(tar::extent{Size, 0} == extents.back());
+		CHECK(tar::detail::data_size(extents) < Size);
+		CHECK(0 == ::lseek(fd.get(), 0, SEEK_CUR));
+
+		// Data are in one of extents, which file systems may align to their blocks.
+		bool found = false;
+		for(auto const& e: extents) {
+			found |= e.offset <= 8 * 1024 * 1024 && 8 * 1024 * 1024 + data.size() <= e.offset + e.size;
+		}
+		CHECK(found);
+	}
+
+	std::filesystem::remove(path);
+}
+
+TEST_CASE("istream of sparse file") {
+	auto const root = std::filesystem::temp_directory_path() / "tar-test-istream-sparse";
+	auto const file = root / "sparse";
+	std::filesystem::remove_all(root);
+	std::filesystem::create_directories(root);
+
+	std::uintmax_t constexpr Size = 8 * 1024 * 1024;
+	{
+		std::ofstream f(file, std::ios::binary);
+		f.seekp(Size / 2);
+		f << "Royale with Cheese";
+	}
+	std::filesystem::resize_file(file, Size);
+
+	std::stringstream archive;
+	{
+		tar::ustar::ostream o(archive.rdbuf());
+		o.next(file, "sparse.bin");
+		o.next(tar::header{.path = "after"});
+	}
+
+	tar::ustar::istream i(archive.rdbuf());
+
+	tar::header h;
+	REQUIRE(static_cast<bool>(i.next(h)));
+	CHECK("sparse.bin" == h.path);
+	CHECK("sparse.bin" == i.pax_path());
+	CHECK(Size == i.real_size());
+	if(i.sparse()) {
+		// Body is the map followed by the data.
+		CHECK(h.size < Size);
+	} else {
+		// File system does not report holes.
+		CHECK(Size == h.size);
+	}
+
+	{
+		// Same as `index` tells.
+		std::stringstream       copy(archive.str());
+		tar::ustar::index const index(copy.rdbuf());
+
+		auto const* e = index.find("sparse.bin");
+		REQUIRE(nullptr != e);
+		CHECK(i.sparse() == e->sparse);
+		CHECK(i.real_size() == e->real_size);
+	}
+
+	REQUIRE(static_cast<bool>(i.next(h)));
+	CHECK("after" == h.path);
+	CHECK_FALSE(i.sparse());
+	CHECK(i.pax_path().empty());
+
+	std::filesystem::remove_all(root);
+}
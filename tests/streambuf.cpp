@@ -26,3 +26,40 @@ TEST_CASE("scoped_streambuf") {
 	REQUIRE(3 == i.gcount());
 	REQUIRE("456" == std::string(r.begin(), r.begin() + 3));
 }
+
+TEST_CASE("bounded_streambuf") {
+	using tar::detail::bounded_streambuf;
+
+	std::stringstream input("0123456789abcdef");
+
+	// Small buffer so reads need refills.
+	bounded_streambuf buf(input.rdbuf(), 3);
+	buf.reset(2, 12);
+
+	std::istream i(&buf);
+
+	std::array<char, 16> r = {0};
+	i.read(r.data(), 2);
+	REQUIRE(static_cast<bool>(i));
+	REQUIRE("23" == std::string(r.begin(), r.begin() + 2));
+	REQUIRE(4 == i.tellg());
+	REQUIRE(8 == buf.remaining());
+
+	REQUIRE('4' == i.get());
+	REQUIRE('5' == i.peek());
+
+	i.seekg(9);
+	REQUIRE('9' == i.get());
+
+	i.read(r.data(), 5);
+	REQUIRE_FALSE(static_cast<bool>(i));
+	REQUIRE(2 == i.gcount());
+	REQUIRE("ab" == std::string(r.begin(), r.begin() + 2));
+	REQUIRE(0 == buf.remaining());
+
+	buf.reset(10, 16);
+	i.clear();
+	i.read(r.data(), 6);
+	REQUIRE(static_cast<bool>(i));
+	REQUIRE("abcdef" == std::string(r.begin(), r.begin() + 6));
+}
@@ -0,0 +1,141 @@
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <tar/tree.hpp>
+#include <tar/ustar.hpp>
+
+TEST_CASE("write_tree") {
+	auto const root = std::filesystem::temp_directory_path() / "tar-test-tree";
+	std::filesystem::remove_all(root);
+	std::filesystem::create_directories(root / "b/d");
+	std::filesystem::create_directories(root / "a");
+	std::ofstream(root / "b/c") << "Royale with Cheese";
+	std::ofstream(root / "b/d/e") << std::string(100000, 'x');
+	std::ofstream(root / "a/f");
+	std::ofstream(root / "g") << "Le Big Mac";
+	std::filesystem::create_directory_symlink("b", root / "h");
+	std::filesystem::create_hard_link(root / "g", root / "b/d/i");
+
+	auto const archive = [&](std::size_t threads) {
+		std::stringstream stream;
+		{
+			tar::ustar::ostream o(stream.rdbuf());
+			tar::write_tree(o, root, "x", {.threads = threads, .read_ahead = 2, .prefetch_size = 1000});
+		}
+		return stream.str();
+	};
+
+	auto const result = archive(4);
+	CHECK(archive(1) == result);
+
+	std::vector<std::pair<std::string, std::string>> const expected = {
+	    {"x", ""},
+	    {"x/a", ""},
+	    {"x/a/f", ""},
+	    {"x/b", ""},
+	    {"x/b/c", "Royale with Cheese"},
+	    {"x/b/d", ""},
+	    {"x/b/d/e", std::string(100000, 'x')},
+	    {"x/b/d/i", "Le Big Mac"},
+	    {"x/g", ""},
+	    {"x/h", ""},
+	};
+
+	std::stringstream   stream(result);
+	tar::ustar::istream i(stream.rdbuf());
+	for(auto const& [name, body]: expected) {
+		CAPTURE(name);
+
+		tar::header h;
+		REQUIRE(static_cast<bool>(i.next(h)));
+		CHECK(name == h.path);
+		CHECK(body.size() == h.size);
+
+		std::string b(h.size, '\0');
+		i.read(b.data(), static_cast<std::streamsize>(b.size()));
+		CHECK(body == b);
+
+		if(name == "x/g") {
+			// Written as a link to the first entry of the same file.
+			CHECK(tar::file_type::hard == h.type);
+			CHECK("x/b/d/i" == h.link);
+		}
+		if(name == "x/h") {
+			CHECK(tar::file_type::symlink == h.type);
+			CHECK("b" == h.link);
+		}
+	}
+
+	tar::header h;
+	CHECK_FALSE(static_cast<bool>(i.next(h)));
+
+	SECTION("without links") {
+		std::stringstream stream;
+		{
+			tar::ustar::ostream o(stream.rdbuf());
+			o.links(nullptr);
+			tar::write_tree(o, root / "g", "g");
+			tar::write_tree(o, root / "b/d/i", "i");
+		}
+
+		tar::ustar::istream i(stream.rdbuf());
+		for(auto const* name: {"g", "i"}) {
+			REQUIRE(static_cast<bool>(i.next(h)));
+			CHECK(name == h.path);
+			CHECK(tar::file_type::regular == h.type);
+			CHECK(10 == h.size);
+		}
+	}
+
+	SECTION("link to a path too long for the link name") {
+		auto const dir = std::string(120, 'd');
+
+		std::stringstream stream;
+		{
+			tar::ustar::ostream o(stream.rdbuf());
+			o.next(root / "g", dir + "/g");
+			o.next(root / "b/d/i", dir + "/i");
+			o.next(root / "b/d/i", "i");
+		}
+
+		// Written in full as no link can refer to the first one.
+		tar::ustar::istream i(stream.rdbuf());
+		for(auto const& name: {dir + "/g", dir + "/i", std::string("i")}) {
+			REQUIRE(static_cast<bool>(i.next(h)));
+			CHECK(name == h.path);
+			CHECK(tar::file_type::regular == h.type);
+			CHECK(10 == h.size);
+			i.ignore(static_cast<std::streamsize>(h.size));
+		}
+	}
+
+	SECTION("by path") {
+		std::stringstream stream;
+		{
+			tar::ustar::ostream o(stream.rdbuf());
+			o.next(root / "g", "g");
+			o.next(root / "b/d/i", "i");
+			o.next(root / "g", "g");
+		}
+
+		tar::ustar::istream i(stream.rdbuf());
+		REQUIRE(static_cast<bool>(i.next(h)));
+		CHECK(tar::file_type::regular == h.type);
+		CHECK(10 == h.size);
+		for(auto const* name: {"i", "g"}) {
+			REQUIRE(static_cast<bool>(i.next(h)));
+			CHECK(name == h.path);
+			CHECK(tar::file_type::hard == h.type);
+			CHECK("g" == h.link);
+			CHECK(0 == h.size);
+		}
+	}
+
+	std::filesystem::remove_all(root);
+}
@@ -0,0 +1,160 @@
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include <tar/uring_fdbuf.hpp>
+#include <tar/ustar.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+std::string pattern(std::size_t n) {
+	std::string v(n, '\0');
+	for(std::size_t i = 0; i < n; ++i) {
+		v[i] = static_cast<char>('a' + (i * 7 + i / 4096) % 26);
+	}
+	return v;
+}
+
+}  // namespace
+
+TEST_CASE("uring_fdbuf") {
+	auto const use_io_uring = GENERATE(true, false);
+	CAPTURE(use_io_uring);
+
+	auto const path = std::filesystem::temp_directory_path() / "tar-test-uring_fdbuf";
+	auto const data = pattern(100000);
+
+	auto const fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	REQUIRE(fd >= 0);
+	{
+		tar::uring_fdbuf buf(fd, {.depth = 3, .block_size = 4096, .use_io_uring = use_io_uring});
+		if(!use_io_uring) {
+			CHECK_FALSE(buf.uses_io_uring());
+		}
+
+		std::iostream s(&buf);
+
+		s << data;
+		REQUIRE(static_cast<std::streamoff>(data.size()) == s.tellp());
+
+		SECTION("reads what is written") {
+			s.seekg(0);
+			std::stringstream r;
+			r << s.rdbuf();
+			CHECK(data == r.str());
+		}
+
+		SECTION("seeks") {
+			std::array<char, 3> r;
+
+			// Forward within the read-ahead, and backward.
+			for(std::size_t const pos: {10, 5000, 9000, 20, 99998}) {
+				CAPTURE(pos);
+
+				s.clear();
+				s.seekg(static_cast<std::streamoff>(pos));
+				s.read(r.data(), r.size());
+				if(pos + r.size() <= data.size()) {
+					CHECK(data.substr(pos, r.size()) == std::string(r.begin(), r.end()));
+					CHECK(static_cast<std::streamoff>(pos + r.size()) == s.tellg());
+				} else {
+					CHECK(s.eof());
+				}
+			}
+
+			s.clear();
+			s.seekp(5000);
+			s << "abc";
+			s.seekg(4999);
+			s.read(r.data(), r.size());
+			CHECK(data.substr(4999, 1) + "ab" == std::string(r.begin(), r.end()));
+
+			CHECK(static_cast<std::streamoff>(data.size()) == s.seekg(0, std::ios_base::end).tellg());
+		}
+	}
+
+	// The offset of the file descriptor is where the buffer is left.
+	CHECK(0 < ::lseek(fd, 0, SEEK_CUR));
+	::close(fd);
+
+	std::filesystem::remove(path);
+}
+
+TEST_CASE("ustar over uring_fdbuf") {
+	auto const use_io_uring = GENERATE(true, false);
+	CAPTURE(use_io_uring);
+
+	auto const root = std::filesystem::temp_directory_path() / "tar-test-uring";
+	std::filesystem::remove_all(root);
+	std::filesystem::create_directories(root);
+	std::ofstream(root / "small") << "Royale with Cheese";
+	std::ofstream(root / "large") << pattern(50000);
+
+	auto const write = [&](std::streambuf* buf) {
+		tar::ustar::ostream o(buf);
+		o.next(root / "small", "small");
+		o.next(root / "large", "large");
+		o.next(tar::header{.path = "patched"});
+		o << "Le Big Mac";
+	};
+
+	std::stringstream expected;
+	write(expected.rdbuf());
+
+	auto const path = root / "archive.tar";
+	auto const fd   = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	REQUIRE(fd >= 0);
+	{
+		tar::uring_fdbuf buf(fd, {.depth = 4, .block_size = 4096, .use_io_uring = use_io_uring});
+		write(&buf);
+	}
+
+	std::stringstream result;
+	result << std::ifstream(path, std::ios::binary).rdbuf();
+	REQUIRE(expected.str() == result.str());
+
+	::lseek(fd, 0, SEEK_SET);
+	{
+		tar::uring_fdbuf    buf(fd, {.depth = 4, .block_size = 4096, .use_io_uring = use_io_uring});
+		tar::ustar::istream i(&buf);
+
+		tar::header h;
+		for(auto const* name: {"small", "large", "patched"}) {
+			REQUIRE(static_cast<bool>(i.next(h)));
+			CHECK(name == h.path);
+		}
+
+		std::string body(h.size, '\0');
+		i.read(body.data(), static_cast<std::streamsize>(body.size()));
+		CHECK("Le Big Mac" == body);
+		CHECK_FALSE(static_cast<bool>(i.next(h)));
+	}
+	::close(fd);
+
+	SECTION("transfer from a pipe is left to the stream") {
+		std::array<int, 2> p;
+		REQUIRE(0 == ::pipe(p.data()));
+
+		auto const fd = ::open(path.c_str(), O_RDWR | O_TRUNC);
+		{
+			tar::uring_fdbuf buf(fd, {.use_io_uring = use_io_uring});
+			CHECK(0 == buf.transfer_from(p[0], 10));
+		}
+		::close(fd);
+		::close(p[0]);
+		::close(p[1]);
+	}
+
+	std::filesystem::remove_all(root);
+}
@@ -1,17 +1,22 @@
 #include <array>
 #include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <string>
+#include <system_error>
 #include <vector>
 
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/generators/catch_generators.hpp>
 
 #include <tar/detail/marshal.hpp>
+#include <tar/detail/pax.hpp>
+#include <tar/index.hpp>
 #include <tar/ustar.hpp>
 
 template<std::size_t N>
@@ -115,6 +120,60 @@ TEST_CASE("header::operator tar::header") {
 	}
 }
 
+TEST_CASE("header_view") {
+	auto const h = tar::ustar::header::from(tar::header{
+	    .path            = std::string(20, 'p') + "/" + std::string(90, 'n'),
+	    .permissions     = std::filesystem::perms(0644),
+	    .uid             = 1000,
+	    .gid             = 100,
+	    .size            = 9ull << 30,
+	    .last_write_time = std::filesystem::file_time_type(std::chrono::seconds(1234567890)),
+	    .type            = tar::file_type::symlink,
+	    .link            = "Royale with Cheese",
+	    .user_name       = "vincent",
+	    .group_name      = "jules",
+	});
+
+	tar::ustar::header_view const v(h);
+	CHECK(std::string(90, 'n') == v.name());
+	CHECK(std::string(20, 'p') == v.prefix());
+	CHECK(v.path_equals(std::string(20, 'p') + "/" + std::string(90, 'n')));
+	CHECK_FALSE(v.path_equals(std::string(20, 'p') + "+" + std::string(90, 'n')));
+	CHECK_FALSE(v.path_equals(std::string(90, 'n')));
+	CHECK("Royale with Cheese" == v.linkname());
+	CHECK("vincent" == v.uname());
+	CHECK("jules" == v.gname());
+
+	CHECK(tar::file_type::symlink == v.type());
+	CHECK(0644 == v.mode());
+	CHECK(1000 == v.uid());
+	CHECK(100 == v.gid());
+	CHECK(9ull << 30 == v.size());
+	CHECK(1234567890 == v.mtime());
+	CHECK(0 == v.devmajor());
+
+	// Same block viewed as raw bytes.
+	auto const* block = reinterpret_cast<char const*>(&h);
+	CHECK(v.name() == tar::ustar::header_view(std::span<char const, tar::ustar::BlockSize>(block, tar::ustar::BlockSize)).name());
+
+	// Fields filled up to their end have no NUL.
+	auto full = h;
+	full.uname.fill('u');
+	CHECK(std::string(32, 'u') == tar::ustar::header_view(full).uname());
+}
+
+TEST_CASE("header of 8 GiB or more") {
+	std::uintmax_t const size = 5ull << 40;
+
+	auto b = tar::ustar::header::from(tar::header{.path = "disk.img", .uid = 1ull << 32, .size = size});
+	CHECK(std::uint8_t(0x80) == std::uint8_t(b.size[0]));
+	CHECK(std::uint8_t(0x80) == std::uint8_t(b.uid[0]));
+
+	tar::header const h = b;
+	CHECK(size == h.size);
+	CHECK(1ull << 32 == h.uid);
+}
+
 TEST_CASE("ostream") {
 	// test fails if environment changes (e.g. uid, gid, mtime, and etc)
 	// so skip this test at this time.
@@ -225,3 +284,330 @@ TEST_CASE("istream") {
 		}
 	}
 }
+
+// Behaves like a pipe; it cannot be seeked.
+class pipebuf: public std::stringbuf {
+   public:
+	using std::stringbuf::stringbuf;
+
+   protected:
+	pos_type seekoff(off_type, std::ios_base::seekdir, std::ios_base::openmode) override {
+		return pos_type(off_type(-1));
+	}
+
+	pos_type seekpos(pos_type, std::ios_base::openmode) override {
+		return pos_type(off_type(-1));
+	}
+};
+
+TEST_CASE("istream on non-seekable stream") {
+	auto const data_root = std::filesystem::path(__FILE__).parent_path() / "data";
+
+	std::stringstream archive;
+	{
+		std::ifstream f(data_root / "Django Unchained.tar", std::ios::binary);
+		archive << f.rdbuf();
+	}
+
+	pipebuf              input(archive.str());
+	tar::ustar::istream i(&input);
+	REQUIRE_FALSE(i.seekable());
+
+	tar::header h;
+
+	// Body is not read at all.
+	REQUIRE(static_cast<bool>(i.next(h)));
+	CHECK("Quentin Tarantino" == h.path);
+
+	// Body is partially read.
+	REQUIRE(static_cast<bool>(i.next(h)));
+	CHECK("Christoph Waltz" == h.path);
+
+	std::array<char, 7> r;
+	i.read(r.data(), r.size());
+	CHECK("October" == std::string(r.begin(), r.end()));
+
+	// Body is fully read.
+	REQUIRE(static_cast<bool>(i.next(h)));
+	CHECK("Jamie Foxx" == h.path);
+	{
+		std::stringstream ss;
+		ss << i.rdbuf();
+		CHECK("December 13, 1967\n" == ss.str());
+	}
+
+	REQUIRE(static_cast<bool>(i.next(h)));
+	CHECK("Samuel Jackson" == h.path);
+
+	REQUIRE(static_cast<bool>(i.next(h)));
+	CHECK("Leonardo DiCaprio" == h.path);
+	{
+		std::stringstream ss;
+		ss << i.rdbuf();
+		CHECK("November 11, 1974\n" == ss.str());
+	}
+
+	REQUIRE_FALSE(static_cast<bool>(i.next(h)));
+	CHECK(i.eof());
+}
+
+TEST_CASE("ostream with known size") {
+	std::string const body = "Royale with Cheese";
+
+	std::stringstream expected;
+	{
+		tar::ustar::ostream o(expected.rdbuf());
+		o.next(tar::header{.path = "Burger"});
+		o << body;
+		o.next(tar::header{.path = "Empty"});
+	}
+
+	SECTION("is written without seek") {
+		pipebuf output;
+		{
+			tar::ustar::ostream o(&output);
+			o.next(tar::header{.path = "Burger"}, body.size());
+			o << body;
+			o.next(tar::header{.path = "Empty"}, 0);
+		}
+
+		REQUIRE(expected.str() == output.str());
+	}
+
+	SECTION("body size must match") {
+		std::stringstream output;
+
+		tar::ustar::ostream o(output.rdbuf());
+		o.next(tar::header{.path = "Burger"}, body.size() + 1);
+		o << body;
+		REQUIRE_THROWS_AS(o.next(tar::header{.path = "Empty"}, 0), std::system_error);
+	}
+}
+
+TEST_CASE("ostream appending") {
+	std::stringstream expected;
+	{
+		tar::ustar::ostream o(expected.rdbuf());
+		o.next(tar::header{.path = "Burger"}, 18);
+		o << "Royale with Cheese";
+		o.next(tar::header{.path = "Fries"}, 10);
+		o << "Le Big Mac";
+	}
+
+	std::stringstream archive;
+	{
+		tar::ustar::ostream o(archive.rdbuf());
+		o.next(tar::header{.path = "Burger"}, 18);
+		o << "Royale with Cheese";
+	}
+
+	SECTION("writes over the end-of-archive marker") {
+		{
+			tar::ustar::ostream o(archive.rdbuf(), tar::ustar::append);
+			o.next(tar::header{.path = "Fries"}, 10);
+			o << "Le Big Mac";
+		}
+
+		REQUIRE(expected.str() == archive.str());
+	}
+
+	SECTION("to an archive without end-of-archive marker") {
+		auto const data = archive.str();
+		archive.str(data.substr(0, data.size() - 2 * tar::ustar::BlockSize));
+		{
+			tar::ustar::ostream o(archive.rdbuf(), tar::ustar::append);
+			o.next(tar::header{.path = "Fries"}, 10);
+			o << "Le Big Mac";
+		}
+
+		REQUIRE(expected.str() == archive.str());
+	}
+
+	SECTION("to an empty stream") {
+		std::stringstream empty;
+		{
+			tar::ustar::ostream o(empty.rdbuf(), tar::ustar::append);
+			o.next(tar::header{.path = "Burger"}, 18);
+			o << "Royale with Cheese";
+			o.next(tar::header{.path = "Fries"}, 10);
+			o << "Le Big Mac";
+		}
+
+		REQUIRE(expected.str() == empty.str());
+	}
+
+	SECTION("truncated archive") {
+		auto const data = archive.str();
+		archive.str(data.substr(0, tar::ustar::BlockSize + 4));
+
+		REQUIRE_THROWS_AS(tar::ustar::ostream(archive.rdbuf(), tar::ustar::append), std::system_error);
+		CHECK(tar::ustar::BlockSize + 4 == archive.str().size());
+	}
+}
+
+TEST_CASE("header::checksum") {
+	auto const data_root = std::filesystem::path(__FILE__).parent_path() / "data";
+
+	std::ifstream      input(data_root / "Quentin Tarantino.tar", std::ios::binary);
+	tar::ustar::header h;
+	input.read(reinterpret_cast<char*>(&h), sizeof(h));
+	REQUIRE(h.verify());
+
+	SECTION("signed sum") {
+		// Some historic implementations sum bytes as signed.
+		h.gname[0] = static_cast<char>(0xE9);
+		std::int64_t sum = h.checksum() - 256;
+		tar::detail::marshal(sum, h.chksum, 6);
+		CHECK(h.verify());
+	}
+
+	SECTION("corrupted") {
+		h.size[0] = '7';
+		CHECK_FALSE(h.verify());
+	}
+}
+
+TEST_CASE("istream verifies checksum") {
+	auto const data_root = std::filesystem::path(__FILE__).parent_path() / "data";
+
+	std::stringstream archive;
+	archive << std::ifstream(data_root / "Django Unchained.tar", std::ios::binary).rdbuf();
+
+	// Corrupts the size of the second entry.
+	auto data = archive.str();
+	data[tar::ustar::BlockSize * 2 + offsetof(tar::ustar::header, size)] = '7';
+	archive.str(data);
+
+	tar::ustar::istream i(archive.rdbuf());
+
+	tar::header h;
+	REQUIRE(static_cast<bool>(i.next(h)));
+
+	SECTION("enabled") {
+		REQUIRE_FALSE(static_cast<bool>(i.next(h)));
+		CHECK(i.bad());
+	}
+
+	SECTION("disabled") {
+		i.verify_checksum(false);
+		REQUIRE(static_cast<bool>(i.next(h)));
+		CHECK("Christoph Waltz" == h.path);
+	}
+}
+
+std::string block_of(tar::ustar::header h) {
+	tar::detail::marshal(h.checksum(), h.chksum, 6);
+	h.chksum[6] = '\0';
+	h.chksum[7] = ' ';
+
+	return std::string(reinterpret_cast<char const*>(&h), sizeof(h));
+}
+
+std::string padded(std::string v) {
+	v.resize(tar::ustar::padded_size(v.size()), '\0');
+	return v;
+}
+
+TEST_CASE("istream with PAX extended header") {
+	std::string const body    = "Royale with Cheese";
+	std::string const path    = std::string(120, 'b') + "/Burger";
+
+	using tar::detail::pax_record;
+	std::string const records = pax_record("uid", "4294967296") + pax_record("size", std::to_string(body.size())) + pax_record("mtime", "-12.25") + pax_record("path", path);
+
+	std::stringstream archive;
+	archive << block_of(tar::ustar::header::from(tar::header{.path = "PaxHeaders/Burger", .size = records.size(), .type = tar::ustar::PaxExtended}));
+	archive << padded(records);
+	// Size in the header is overridden.
+	archive << block_of(tar::ustar::header::from(tar::header{.path = "Burger", .size = 0}));
+	archive << padded(body);
+	archive << block_of(tar::ustar::header::from(tar::header{.path = "Fries", .size = 0}));
+	archive << std::string(tar::ustar::BlockSize * 2, '\0');
+
+	SECTION("istream") {
+		tar::ustar::istream i(archive.rdbuf());
+
+		tar::header h;
+		REQUIRE(static_cast<bool>(i.next(h)));
+		CHECK(path == h.path);
+		CHECK(path == i.pax_path());
+		CHECK_FALSE(i.sparse());
+		CHECK(body.size() == i.real_size());
+		CHECK(body.size() == h.size);
+		CHECK(1ull << 32 == h.uid);
+		CHECK(-12 == std::chrono::duration_cast<std::chrono::seconds>(h.last_write_time.time_since_epoch()).count());
+		{
+			std::stringstream ss;
+			ss << i.rdbuf();
+			CHECK(body == ss.str());
+		}
+
+		REQUIRE(static_cast<bool>(i.next(h)));
+		CHECK("Fries" == h.path);
+		CHECK(0 == h.size);
+		CHECK(i.pax_path().empty());
+	}
+
+	SECTION("index") {
+		tar::ustar::index const index(archive.rdbuf());
+		REQUIRE(2 == index.size());
+
+		auto const* e = index.find(path);
+		REQUIRE(nullptr != e);
+		CHECK(body.size() == e->size);
+		CHECK(nullptr == index.find("Burger"));
+
+		std::stringstream ss;
+		ss << index.open(*e).rdbuf();
+		CHECK(body == ss.str());
+	}
+
+	SECTION("malformed") {
+		auto data = archive.str();
+		data[tar::ustar::BlockSize] = 'x';
+
+		std::stringstream broken(data);
+		tar::ustar::istream i(broken.rdbuf());
+
+		tar::header h;
+		REQUIRE_FALSE(static_cast<bool>(i.next(h)));
+		CHECK(i.bad());
+	}
+}
+
+TEST_CASE("header with invalid size") {
+	// Negative, or so large the position of the next header wraps around onto the same header.
+	auto const size = GENERATE(std::intmax_t(-512), std::numeric_limits<std::intmax_t>::max());
+	CAPTURE(size);
+
+	auto h = tar::ustar::header::from(tar::header{.path = "Marsellus Wallace"});
+	tar::detail::marshal(size, h.size);
+	REQUIRE(tar::detail::is_base256(h.size.data()));
+
+	std::stringstream archive;
+	archive << block_of(h) << std::string(tar::ustar::BlockSize * 2, '\0');
+
+	SECTION("istream") {
+		tar::ustar::istream i(archive.rdbuf());
+
+		tar::header e;
+		CHECK_FALSE(static_cast<bool>(i.next(e)));
+		CHECK(i.bad());
+	}
+
+	SECTION("index") {
+		CHECK_THROWS_AS(tar::ustar::index(archive.rdbuf()), std::system_error);
+	}
+}
+
+TEST_CASE("malformed PAX records") {
+	auto const ignore = [](std::string_view, std::string_view) { };
+
+	// Ends right after the length.
+	std::array<char, 2> const digits = {'1', '2'};
+	CHECK_FALSE(tar::detail::for_each_pax_record(std::string_view(digits.data(), digits.size()), ignore));
+
+	CHECK_FALSE(tar::detail::for_each_pax_record("12 a=b\n", ignore));
+	CHECK_FALSE(tar::detail::for_each_pax_record("6 ab\n", ignore));
+	CHECK(tar::detail::for_each_pax_record("6 a=b\n", ignore));
+}